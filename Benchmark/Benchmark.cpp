@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "CImg.h"
+#include "HW1Utils.h"
+using namespace std;
+using namespace cimg_library;
+
+// Head-to-head comparison of the hand-written paths of HW1Utils and the
+// CImg built-ins they replace. Every row reports time per operation,
+// throughput and difference from the CImg output; rotation rows also
+// report accuracy against the exactly rotated test pattern.
+class Benchmark {
+public:
+	// Smooth test pattern, so that the exact rotated image is known at any
+	// point and accuracy does not depend on any of the measured paths.
+	static float Pattern(float x, float y, int c) {
+		return 127.5f + 100.0f * sin(x * 0.05f + c) * cos(y * 0.07f) + 20.0f * sin((x + y) * 0.011f);
+	}
+
+	static CImg<unsigned char> MakeImage(int width, int height) {
+		CImg<unsigned char> image(width, height, 1, 3);
+		for (int c = 0; c < 3; c++) {
+			for (int h = 0; h < height; h++) {
+				for (int w = 0; w < width; w++) {
+					image(w, h, 0, c) = (unsigned char)(Pattern((float)w, (float)h, c) + 0.5f);
+				}
+			}
+		}
+		return image;
+	}
+
+	// Seconds per call, repeated until at least minimalTime elapsed.
+	template<typename F>
+	static double TimePerRun(F function, double minimalTime = 0.3) {
+		function();
+		int runs = 0;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		double elapsed = 0.0;
+		do {
+			function();
+			runs++;
+			elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		} while (elapsed < minimalTime || runs < 3);
+		return elapsed / runs;
+	}
+
+	// Compares image with the CImg output reference. Images of different
+	// size (rotations) are compared on their common region, aligned at the
+	// centers. differing is the percentage of pixels with any channel
+	// different, meanDifference the mean absolute difference of values.
+	static void Difference(const CImg<unsigned char>& image, const CImg<unsigned char>& reference,
+		double& differing, double& meanDifference) {
+		int width = min(image.width(), reference.width());
+		int height = min(image.height(), reference.height());
+		int channels = min(image.spectrum(), reference.spectrum());
+		int imageX = (image.width() - width) / 2;
+		int imageY = (image.height() - height) / 2;
+		int referenceX = (reference.width() - width) / 2;
+		int referenceY = (reference.height() - height) / 2;
+		long long pixels = 0, sum = 0;
+
+		for (int h = 0; h < height; h++) {
+			for (int w = 0; w < width; w++) {
+				bool different = false;
+				for (int c = 0; c < channels; c++) {
+					int delta = abs((int)image(imageX + w, imageY + h, 0, c) -
+						(int)reference(referenceX + w, referenceY + h, 0, c));
+					sum += delta;
+					different = different || delta != 0;
+				}
+				pixels += different ? 1 : 0;
+			}
+		}
+		long long count = (long long)width * height;
+		differing = count ? 100.0 * pixels / count : 0.0;
+		meanDifference = count && channels ? (double)sum / (count * channels) : 0.0;
+	}
+
+	// Mean absolute error and PSNR against the exact rotation of the
+	// pattern. Image is assumed to map source point s to
+	// R(angle) * (s - sourceCenter) + rotatedCenter. Only pixels whose
+	// source point lies at least 2 pixels inside the source are compared,
+	// so differences of border handling do not count.
+	static void MeasureRotation(const CImg<unsigned char>& rotated, int width, int height, float angle,
+		float sourceCenterX, float sourceCenterY, float rotatedCenterX, float rotatedCenterY,
+		double& meanError, double& psnr) {
+		double radians = angle / 180.0 * 3.14159265358979;
+		double cosine = cos(radians);
+		double sine = sin(radians);
+		double sum = 0.0, squares = 0.0;
+		long long count = 0;
+
+		for (int c = 0; c < rotated.spectrum(); c++) {
+			for (int h = 0; h < rotated.height(); h++) {
+				for (int w = 0; w < rotated.width(); w++) {
+					double dx = w - rotatedCenterX;
+					double dy = h - rotatedCenterY;
+					double x = cosine * dx + sine * dy + sourceCenterX;
+					double y = -sine * dx + cosine * dy + sourceCenterY;
+					if (x < 2.0 || y < 2.0 || x > width - 3.0 || y > height - 3.0) {
+						continue;
+					}
+					double error = rotated(w, h, 0, c) - Pattern((float)x, (float)y, c);
+					sum += fabs(error);
+					squares += error * error;
+					count++;
+				}
+			}
+		}
+		meanError = count ? sum / count : 0.0;
+		double mse = count ? squares / count : 0.0;
+		psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+	}
+
+	static void PrintHeader() {
+		printf("%-7s %5s %6s %6s  %-18s %10s %10s %-7s %7s %7s %7s %6s\n", "group", "size", "param", "count",
+			"method", "ms/op", "rate", "unit", "diff%", "diff", "err", "PSNR");
+	}
+
+	// One result row. units is the amount of work per operation, reported
+	// in millions per second; error and psnr are printed if not negative.
+	static void PrintRow(const char* group, int size, float parameter, int count, const char* method,
+		double seconds, double units, const char* unit, double differing, double meanDifference,
+		double error = -1.0, double psnr = -1.0) {
+		seconds = max(seconds, 1e-9);
+		printf("%-7s %5d %6.1f %6d  %-18s %10.3f %10.2f %-7s %7.2f %7.3f", group, size, parameter, count, method,
+			seconds * 1000.0, units / seconds / 1e6, unit, differing, meanDifference);
+		if (error >= 0.0) {
+			printf(" %7.3f %6.2f\n", error, psnr);
+		}
+		else {
+			printf(" %7s %6s\n", "-", "-");
+		}
+	}
+
+	static void RotationBenchmark(const vector<int>& sizes, const vector<float>& angles) {
+		for (size_t s = 0; s < sizes.size(); s++) {
+			int size = sizes[s];
+			CImg<unsigned char> image = MakeImage(size, size);
+			CImg<unsigned char> rotated;
+			RemapCache cache;
+
+			for (size_t a = 0; a < angles.size(); a++) {
+				float angle = angles[a];
+				int newWidth, newHeight;
+				RotationEngine::RotatedSize(size, size, angle, newWidth, newHeight);
+				float centerX = (float)(size / 2);
+				float centerY = (float)(size / 2);
+				float rotatedX = centerX + (newWidth - size) / 2.0f;
+				float rotatedY = centerY + (newHeight - size) / 2.0f;
+				double pixels = (double)newWidth * newHeight;
+				double seconds, differing, difference, meanError, psnr;
+
+				// CImg rotates in place, so every run works on a fresh copy;
+				// the copy itself is not counted.
+				CImg<unsigned char> reference;
+				double copySeconds = TimePerRun([&]() {
+					reference = image;
+				});
+				seconds = TimePerRun([&]() {
+					reference = image;
+					HW1Utils::RotateImage(&reference, angle, true, false);
+				}) - copySeconds;
+				// CImg rotates around the exact middle of both images.
+				MeasureRotation(reference, size, size, angle, (size - 1) / 2.0f, (size - 1) / 2.0f,
+					(reference.width() - 1) / 2.0f, (reference.height() - 1) / 2.0f, meanError, psnr);
+				PrintRow("rotate", size, angle, 1, "CImg", seconds,
+					(double)reference.width() * reference.height(), "Mpix/s", 0.0, 0.0, meanError, psnr);
+
+				auto report = [&](const char* method, double seconds) {
+					Difference(rotated, reference, differing, difference);
+					MeasureRotation(rotated, size, size, angle, centerX, centerY, rotatedX, rotatedY,
+						meanError, psnr);
+					PrintRow("rotate", size, angle, 1, method, seconds, pixels, "Mpix/s", differing, difference,
+						meanError, psnr);
+				};
+
+				report("backward nearest", TimePerRun([&]() {
+					HW1Utils::RotateImage(&image, &rotated, angle, Interpolation::Nearest);
+				}));
+				report("backward bilinear", TimePerRun([&]() {
+					HW1Utils::RotateImage(&image, &rotated, angle, Interpolation::Bilinear);
+				}));
+				report("cached bilinear", TimePerRun([&]() {
+					HW1Utils::RotateImage(&image, &rotated, angle, &cache, Interpolation::Bilinear);
+				}));
+				report("three-shear", TimePerRun([&]() {
+					HW1Utils::RotateImageThreeShear(&image, &rotated, angle);
+				}));
+			}
+		}
+	}
+
+	static void CircleBenchmark(const vector<int>& sizes, const vector<float>& radii, const vector<int>& counts) {
+		for (size_t s = 0; s < sizes.size(); s++) {
+			int size = sizes[s];
+			CImg<unsigned char> background = MakeImage(size, size);
+
+			for (size_t r = 0; r < radii.size(); r++) {
+				for (size_t n = 0; n < counts.size(); n++) {
+					float radius = floor(radii[r] + 0.5f);
+					int count = counts[n];
+					double area = count * 3.14159265358979 * radius * radius;
+					// Skip sweeps that would paint the image over many times.
+					if (area > 8.0 * size * size) {
+						continue;
+					}
+
+					// CImg takes integer centers and radii; integer input keeps the
+					// difference about the implementations, not about truncation.
+					mt19937 random(1234);
+					uniform_int_distribution<int> position(0, size - 1);
+					vector<Circle> circles(count);
+					for (int i = 0; i < count; i++) {
+						Circle circle = { (float)position(random), (float)position(random), radius, { 255, 255, 0 } };
+						circles[i] = circle;
+					}
+
+					CImg<unsigned char> reference = background;
+					CImg<unsigned char> image;
+					double differing, difference;
+
+					double seconds = TimePerRun([&]() {
+						for (int i = 0; i < count; i++) {
+							HW1Utils::DrawCircle(&reference, circles[i].x, circles[i].y, radius, true);
+						}
+					});
+					PrintRow("circle", size, radius, count, "CImg", seconds, area, "Mpix/s", 0.0, 0.0);
+
+					image = background;
+					seconds = TimePerRun([&]() {
+						for (int i = 0; i < count; i++) {
+							HW1Utils::DrawCircle(&image, circles[i].x, circles[i].y, radius, false);
+						}
+					});
+					Difference(image, reference, differing, difference);
+					PrintRow("circle", size, radius, count, "spans", seconds, area, "Mpix/s", differing, difference);
+
+					image = background;
+					seconds = TimePerRun([&]() {
+						HW1Utils::DrawCircles(&image, circles);
+					});
+					Difference(image, reference, differing, difference);
+					PrintRow("circle", size, radius, count, "spans batched", seconds, area, "Mpix/s",
+						differing, difference);
+				}
+			}
+		}
+	}
+
+	static void LineBenchmark(const vector<int>& sizes, const vector<int>& counts) {
+		unsigned char red[] = { 255, 0, 0 };
+
+		for (size_t s = 0; s < sizes.size(); s++) {
+			int size = sizes[s];
+			CImg<unsigned char> background = MakeImage(size, size);
+
+			for (size_t n = 0; n < counts.size(); n++) {
+				int count = counts[n];
+				mt19937 random(5678);
+				uniform_real_distribution<float> position(0.0f, (float)(size - 1));
+				vector<Segment> segments(count);
+				// Pixels drawn, one per step along the major axis.
+				double length = 0.0;
+				for (int i = 0; i < count; i++) {
+					Segment segment = { position(random), position(random), position(random), position(random),
+						{ 255, 0, 0 } };
+					segments[i] = segment;
+					length += max(fabs(segment.x1 - segment.x0), fabs(segment.y1 - segment.y0)) + 1.0;
+				}
+
+				CImg<unsigned char> reference = background;
+				CImg<unsigned char> image;
+				double differing, difference;
+
+				double seconds = TimePerRun([&]() {
+					for (int i = 0; i < count; i++) {
+						const Segment& l = segments[i];
+						HW1Utils::DrawLine(&reference, l.x0, l.y0, l.x1, l.y1, red, true);
+					}
+				});
+				PrintRow("line", size, 0.0f, count, "CImg", seconds, length, "Mpix/s", 0.0, 0.0);
+
+				image = background;
+				seconds = TimePerRun([&]() {
+					for (int i = 0; i < count; i++) {
+						const Segment& l = segments[i];
+						HW1Utils::DrawLine(&image, l.x0, l.y0, l.x1, l.y1, red, false);
+					}
+				});
+				Difference(image, reference, differing, difference);
+				PrintRow("line", size, 0.0f, count, "bresenham", seconds, length, "Mpix/s", differing, difference);
+
+				image = background;
+				seconds = TimePerRun([&]() {
+					HW1Utils::DrawSegments(&image, segments);
+				});
+				Difference(image, reference, differing, difference);
+				PrintRow("line", size, 0.0f, count, "bresenham batched", seconds, length, "Mpix/s",
+					differing, difference);
+
+				// Blending accumulates over the timed runs, so the difference
+				// is measured on a single pass.
+				seconds = TimePerRun([&]() {
+					HW1Utils::DrawSegments(&image, segments, true);
+				});
+				image = background;
+				HW1Utils::DrawSegments(&image, segments, true);
+				Difference(image, reference, differing, difference);
+				PrintRow("line", size, 0.0f, count, "wu batched", seconds, length, "Mpix/s", differing, difference);
+			}
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	// Image sizes may be given on command line.
+	vector<int> sizes;
+	for (int i = 1; i < argc; i++) {
+		sizes.push_back(atoi(argv[i]));
+	}
+	if (sizes.empty()) {
+		sizes.push_back(512);
+		sizes.push_back(2048);
+		sizes.push_back(4096);
+	}
+	vector<float> angles;
+	angles.push_back(10.0f);
+	angles.push_back(33.0f);
+	angles.push_back(45.0f);
+	angles.push_back(120.0f);
+	vector<float> radii;
+	radii.push_back(2.0f);
+	radii.push_back(8.0f);
+	radii.push_back(32.0f);
+	radii.push_back(128.0f);
+	vector<int> counts;
+	counts.push_back(16);
+	counts.push_back(1024);
+
+	Benchmark::PrintHeader();
+	Benchmark::RotationBenchmark(sizes, angles);
+	Benchmark::CircleBenchmark(sizes, radii, counts);
+	Benchmark::LineBenchmark(sizes, counts);
+	return 0;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <iostream>
+#include <cmath>
+#include "CImg.h"
+#include "Rasterizer.h"
+#include "RemapTable.h"
+#include "RotationEngine.h"
+using namespace std;
+using namespace cimg_library;
+
+class HW1Utils {
+private:
+	static float L2Distance(float x0, float y0, float x1, float y1) {
+		float deltaX = x0 - x1;
+		float deltaY = y0 - y1;
+		return sqrt(deltaX * deltaX + deltaY * deltaY);
+	}
+
+	static void RotatePoint(float& x, float& y, float x0, float y0, float angle, bool forward = true) {
+		angle = (angle / 180.0) * 3.1415926;
+		float answerX = 0.0, answerY = 0.0;
+
+		if (forward) {
+			answerX = (x - x0) * cos(angle) - (y - y0) * sin(angle) + x0;
+			answerY = (x - x0) * sin(angle) + (y - y0) * cos(angle) + y0;
+		}
+		else {
+			answerX = (x - x0) * cos(angle) + (y - y0) * sin(angle) + x0;
+			answerY = -(x - x0) * sin(angle) + (y - y0) * cos(angle) + y0;
+		}
+
+		x = answerX;
+		y = answerY;
+	}
+public:
+	static void DrawCircle(CImg<unsigned char>* image, float x, float y, float r, bool useCImg = false) {
+		//float x = 60.0;
+		//float y = 60.0;
+		//float r = 2.0;
+		unsigned char yellow[] = { 255, 255, 0 };
+
+		if (useCImg) {
+			// Same rounded center and radius as Rasterizer gets for integer input.
+			image->draw_circle((int)floor(x + 0.5f), (int)floor(y + 0.5f), (int)floor(r + 0.5f), yellow, 1.0);
+		}
+		else {
+			Rasterizer::DrawCircle(*image, x, y, r, yellow);
+		}
+	}
+
+	// Draws all markers in one banded pass, see Rasterizer::DrawCircles.
+	static void DrawCircles(CImg<unsigned char>* image, const vector<Circle>& circles, int threadCount = 0) {
+		Rasterizer::DrawCircles(*image, circles, threadCount);
+	}
+
+	static void DrawLine(CImg<unsigned char>* image, bool useCImg) {
+		float length = 100.0;
+		float x = 0.0;
+		float y = 0.0;
+		unsigned char red[] = { 255, 0, 0 };
+
+		if (useCImg) {
+			float sideLength = 50.0 * sqrt(2);
+			image->draw_line(0, 0, sideLength, sideLength, red, 1.0, 0xFFFFFFFF, false);
+		}
+		else {
+			float xi = length - 1;
+			float yi = 0;
+			HW1Utils::RotatePoint(xi, yi, x, y, 45.0);
+			Rasterizer::DrawLine(*image, x, y, xi, yi, red);
+		}
+	}
+
+	static void DrawLine(CImg<unsigned char>* image, float x0, float y0, float x1, float y1,
+		const unsigned char* color, bool useCImg = false, bool antialiased = false) {
+		if (useCImg) {
+			// Same rounded endpoints as the aliased Rasterizer line.
+			image->draw_line((int)floor(x0 + 0.5f), (int)floor(y0 + 0.5f),
+				(int)floor(x1 + 0.5f), (int)floor(y1 + 0.5f), color, 1.0);
+		}
+		else {
+			Rasterizer::DrawLine(*image, x0, y0, x1, y1, color, antialiased);
+		}
+	}
+
+	// Draws an overlay of many segments, see Rasterizer::DrawSegments.
+	static void DrawSegments(CImg<unsigned char>* image, const vector<Segment>& segments, bool antialiased = false) {
+		Rasterizer::DrawSegments(*image, segments, antialiased);
+	}
+
+	static CImg<unsigned char>* RotateImage(CImg<unsigned char>* image, float angle, bool useCImg, bool useForward) {
+		int width = image->width();
+		int height = image->height();
+
+		if (useCImg) {
+			image->rotate(angle);
+			return image;
+		}
+
+		float left = (float)(0x7FFFFFFF);
+		float right = -(float)(0x7FFFFFFF);
+		float top = (float)(0x7FFFFFFF);
+		float bottom = -(float)(0x7FFFFFFF);
+		float centerX = width / 2;
+		float centerY = height / 2;
+		float xs[] = { 0.0, width - 1, 0.0, width - 1 };
+		float ys[] = { 0.0, 0.0, height - 1, height - 1 };
+		for (int i = 0; i < 4; i++) {
+			HW1Utils::RotatePoint(xs[i], ys[i], centerX, centerY, angle);
+			left = min(left, xs[i]);
+			right = max(right, xs[i]);
+			top = min(top, ys[i]);
+			bottom = max(bottom, ys[i]);
+		}
+		float newWidth = right - left + 1.0;
+		float newHeight = bottom - top + 1.0;
+		float deltaX = (newWidth - width) / 2;
+		float deltaY = (newHeight - height) / 2;
+		CImg<unsigned char>* answer = new CImg<unsigned char>(ceil(newWidth), ceil(newHeight), 1, 3, 0);
+		if (useForward) {
+			for (int w = 0; w < width; w++) {
+				for (int h = 0; h < height; h++) {
+					float x = w;
+					float y = h;
+					HW1Utils::RotatePoint(x, y, centerX, centerY, angle);
+					for (int c = 0; c < 3; c++) {
+						answer->operator()(x + deltaX, y + deltaY, 0, c) =
+							image->operator()(w, h, 0, c);
+					}
+				}
+			}
+		}
+		else {
+			RotationEngine::Rotate(*image, *answer, angle);
+		}
+		return answer;
+	}
+
+	static void RotateImage(CImg<unsigned char>* image, CImg<unsigned char>* destination, float angle,
+		Interpolation interpolation = Interpolation::Nearest) {
+		RotationEngine::Rotate(*image, *destination, angle, interpolation);
+	}
+
+	static void RotateImage(CImg<unsigned char>* image, CImg<unsigned char>* destination, float angle,
+		RemapCache* cache, Interpolation interpolation = Interpolation::Nearest) {
+		// Tables cover 2D images only; anything else takes the engine path.
+		if (!cache->GetRotation(angle, image->width(), image->height(), interpolation)->Apply(*image, *destination)) {
+			RotationEngine::Rotate(*image, *destination, angle, interpolation);
+		}
+	}
+
+	static void RotateImageThreeShear(CImg<unsigned char>* image, CImg<unsigned char>* destination, float angle) {
+		RotationEngine::RotateThreeShear(*image, *destination, angle);
+	}
+};
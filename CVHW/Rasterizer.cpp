@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Rasterizer.h"
+#include "RotationEngine.h"
+using namespace std;
+
+void Rasterizer::DrawCircle(CImg<unsigned char>& image, float x, float y, float r,
+	const unsigned char* color) {
+	Circle circle = { x, y, r, { color[0], color[1], color[2] } };
+	int rowBegin, rowEnd;
+	if (CircleRows(circle, image.width(), image.height(), rowBegin, rowEnd)) {
+		FillCircleRows(image, circle, rowBegin, rowEnd);
+	}
+}
+
+void Rasterizer::DrawCircles(CImg<unsigned char>& image, const vector<Circle>& circles, int threadCount) {
+	int bandCount = (image.height() + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	if (bandCount == 0 || circles.empty()) {
+		return;
+	}
+
+	// Counting sort of circle indices into bands. Indices stay in increasing
+	// order inside every band, which keeps the drawing order.
+	vector<int> first(bandCount + 1, 0);
+	for (size_t i = 0; i < circles.size(); i++) {
+		int rowBegin, rowEnd;
+		if (CircleRows(circles[i], image.width(), image.height(), rowBegin, rowEnd)) {
+			for (int band = rowBegin / BAND_HEIGHT; band <= (rowEnd - 1) / BAND_HEIGHT; band++) {
+				first[band + 1]++;
+			}
+		}
+	}
+	for (int band = 0; band < bandCount; band++) {
+		first[band + 1] += first[band];
+	}
+	vector<int> indices(first[bandCount]);
+	vector<int> next(first.begin(), first.end() - 1);
+	for (size_t i = 0; i < circles.size(); i++) {
+		int rowBegin, rowEnd;
+		if (CircleRows(circles[i], image.width(), image.height(), rowBegin, rowEnd)) {
+			for (int band = rowBegin / BAND_HEIGHT; band <= (rowEnd - 1) / BAND_HEIGHT; band++) {
+				indices[next[band]++] = (int)i;
+			}
+		}
+	}
+
+	RotationEngine::ParallelFor(bandCount, threadCount, 2, [&](int bandBegin, int bandEnd) {
+		for (int band = bandBegin; band < bandEnd; band++) {
+			int bandTop = band * BAND_HEIGHT;
+			int bandBottom = min(bandTop + BAND_HEIGHT, image.height());
+			for (int i = first[band]; i < first[band + 1]; i++) {
+				const Circle& circle = circles[indices[i]];
+				int rowBegin, rowEnd;
+				CircleRows(circle, image.width(), image.height(), rowBegin, rowEnd);
+				FillCircleRows(image, circle, max(rowBegin, bandTop), min(rowEnd, bandBottom));
+			}
+		}
+	});
+}
+
+bool Rasterizer::CircleRows(const Circle& circle, int width, int height, int& rowBegin, int& rowEnd) {
+	// Also rejects NaN.
+	if (!(circle.r >= 0.0f && circle.x + circle.r >= 0.0f && circle.x - circle.r <= width - 1)) {
+		return false;
+	}
+	float top = ceil(circle.y - circle.r);
+	float bottom = floor(circle.y + circle.r);
+	if (!(top < height && bottom >= 0.0f)) {
+		return false;
+	}
+	rowBegin = (int)max(top, 0.0f);
+	rowEnd = (int)min(bottom, (float)(height - 1)) + 1;
+	return rowBegin < rowEnd;
+}
+
+void Rasterizer::FillCircleRows(CImg<unsigned char>& image, const Circle& circle, int rowBegin, int rowEnd) {
+	float x = circle.x;
+	float radius2 = circle.r * circle.r;
+	// Column nearest to the center; if it is outside the circle on some row,
+	// the whole row is.
+	int center = (int)floor(x + 0.5f);
+	// Span [left, right] of the previous row, empty if left > right.
+	int left = center + 1;
+	int right = center;
+
+	for (int h = rowBegin; h < rowEnd; h++) {
+		float dy = h - circle.y;
+		float rest = radius2 - dy * dy;
+
+		// Ends of the span move by a few columns between neighbouring rows,
+		// so they are adjusted incrementally instead of solved with sqrt.
+		if (left > right) {
+			if ((center - x) * (center - x) > rest) {
+				continue;
+			}
+			left = right = center;
+		}
+		while ((left - 1 - x) * (left - 1 - x) <= rest) {
+			left--;
+		}
+		while (left <= right && (left - x) * (left - x) > rest) {
+			left++;
+		}
+		while ((right + 1 - x) * (right + 1 - x) <= rest) {
+			right++;
+		}
+		while (right >= left && (right - x) * (right - x) > rest) {
+			right--;
+		}
+		if (left <= right) {
+			FillSpan(image, h, left, right, circle.color);
+		}
+	}
+}
+
+void Rasterizer::FillSpan(CImg<unsigned char>& image, int row, int left, int right, const unsigned char* color) {
+	left = max(left, 0);
+	right = min(right, image.width() - 1);
+	if (left > right) {
+		return;
+	}
+	int channels = min(image.spectrum(), 3);
+	for (int c = 0; c < channels; c++) {
+		memset(image.data(left, row, 0, c), color[c], right - left + 1);
+	}
+}
+
+// Endpoints farther away than this are clipped in float first, so that the
+// integer arithmetic of the line walkers cannot overflow.
+static const float COORDINATE_LIMIT = (float)(1 << 20);
+
+// Liang-Barsky clipping of the segment to [left, right] x [top, bottom].
+static bool ClipLine(float& x0, float& y0, float& x1, float& y1, float left, float top, float right, float bottom) {
+	float dx = x1 - x0;
+	float dy = y1 - y0;
+	float p[] = { -dx, dx, -dy, dy };
+	float q[] = { x0 - left, right - x0, y0 - top, bottom - y0 };
+	float t0 = 0.0f, t1 = 1.0f;
+	for (int i = 0; i < 4; i++) {
+		if (p[i] == 0.0f) {
+			if (q[i] < 0.0f) {
+				return false;
+			}
+			continue;
+		}
+		float t = q[i] / p[i];
+		if (p[i] < 0.0f) {
+			t0 = max(t0, t);
+		}
+		else {
+			t1 = min(t1, t);
+		}
+	}
+	if (t0 > t1) {
+		return false;
+	}
+	x1 = x0 + dx * t1;
+	y1 = y0 + dy * t1;
+	x0 = x0 + dx * t0;
+	y0 = y0 + dy * t0;
+	return true;
+}
+
+// a / b rounded up, for b > 0.
+static long long CeilDivide(long long a, long long b) {
+	return a >= 0 ? (a + b - 1) / b : -(-a / b);
+}
+
+void Rasterizer::DrawLine(CImg<unsigned char>& image, float x0, float y0, float x1, float y1,
+	const unsigned char* color, bool antialiased) {
+	// Also rejects NaN and infinity.
+	if (!(fabs(x0) <= COORDINATE_LIMIT && fabs(y0) <= COORDINATE_LIMIT &&
+		fabs(x1) <= COORDINATE_LIMIT && fabs(y1) <= COORDINATE_LIMIT)) {
+		if (!(isfinite(x0) && isfinite(y0) && isfinite(x1) && isfinite(y1)) ||
+			!ClipLine(x0, y0, x1, y1, -1.0f, -1.0f, (float)image.width(), (float)image.height())) {
+			return;
+		}
+	}
+
+	if (antialiased) {
+		DrawWu(image, x0, y0, x1, y1, color);
+	}
+	else {
+		DrawBresenham(image, (int)floor(x0 + 0.5f), (int)floor(y0 + 0.5f),
+			(int)floor(x1 + 0.5f), (int)floor(y1 + 0.5f), color);
+	}
+}
+
+void Rasterizer::DrawPolyline(CImg<unsigned char>& image, const vector<Vertex>& vertices,
+	const unsigned char* color, bool closed, bool antialiased) {
+	for (size_t i = 1; i < vertices.size(); i++) {
+		DrawLine(image, vertices[i - 1].x, vertices[i - 1].y, vertices[i].x, vertices[i].y, color, antialiased);
+	}
+	if (closed && vertices.size() > 2) {
+		DrawLine(image, vertices.back().x, vertices.back().y, vertices[0].x, vertices[0].y, color, antialiased);
+	}
+}
+
+void Rasterizer::DrawSegments(CImg<unsigned char>& image, const vector<Segment>& segments, bool antialiased) {
+	for (size_t i = 0; i < segments.size(); i++) {
+		const Segment& s = segments[i];
+		DrawLine(image, s.x0, s.y0, s.x1, s.y1, s.color, antialiased);
+	}
+}
+
+void Rasterizer::DrawBresenham(CImg<unsigned char>& image, int x0, int y0, int x1, int y1,
+	const unsigned char* color) {
+	int width = image.width();
+	int channels = min(image.spectrum(), 3);
+	unsigned char* planes[3];
+	for (int c = 0; c < channels; c++) {
+		planes[c] = image.data(0, 0, 0, c);
+	}
+	int dx = x1 - x0;
+	int dy = y1 - y0;
+	int stepX = dx >= 0 ? 1 : -1;
+	int stepY = dy >= 0 ? 1 : -1;
+
+	if (abs(dx) >= abs(dy)) {
+		WalkBresenham(x0, y0, stepX, stepY, abs(dx), abs(dy), width, image.height(), [&](int x, int y) {
+			size_t offset = (size_t)y * width + x;
+			for (int c = 0; c < channels; c++) {
+				planes[c][offset] = color[c];
+			}
+		});
+	}
+	else {
+		WalkBresenham(y0, x0, stepY, stepX, abs(dy), abs(dx), image.height(), width, [&](int y, int x) {
+			size_t offset = (size_t)y * width + x;
+			for (int c = 0; c < channels; c++) {
+				planes[c][offset] = color[c];
+			}
+		});
+	}
+}
+
+template<typename F>
+void Rasterizer::WalkBresenham(int major0, int minor0, int majorStep, int minorStep, int count, int minorCount,
+	int majorLimit, int minorLimit, F plot) {
+	// Steps i visible along the major axis.
+	long long begin = majorStep > 0 ? -(long long)major0 : (long long)major0 - (majorLimit - 1);
+	long long end = majorStep > 0 ? (long long)majorLimit - 1 - major0 : (long long)major0;
+	begin = max(begin, 0LL);
+	end = min(end, (long long)count);
+
+	// Minor steps k visible along the minor axis, turned into steps i.
+	long long kBegin = minorStep > 0 ? -(long long)minor0 : (long long)minor0 - (minorLimit - 1);
+	long long kEnd = minorStep > 0 ? (long long)minorLimit - 1 - minor0 : (long long)minor0;
+	kBegin = max(kBegin, 0LL);
+	kEnd = min(kEnd, (long long)minorCount);
+	if (kBegin > kEnd) {
+		return;
+	}
+	long long twiceCount = 2LL * count;
+	long long twiceMinor = 2LL * minorCount;
+	if (minorCount > 0) {
+		begin = max(begin, CeilDivide(twiceCount * kBegin - count, twiceMinor));
+		end = min(end, CeilDivide(twiceCount * (kEnd + 1) - count, twiceMinor) - 1);
+	}
+	if (begin > end) {
+		return;
+	}
+	if (count == 0) {
+		plot(major0, minor0);
+		return;
+	}
+
+	// Error term is the remainder of the division defining k(i).
+	long long numerator = twiceMinor * begin + count;
+	long long k = numerator / twiceCount;
+	long long error = numerator - k * twiceCount;
+	int major = major0 + majorStep * (int)begin;
+	int minor = minor0 + minorStep * (int)k;
+	for (long long i = begin; i <= end; i++) {
+		plot(major, minor);
+		major += majorStep;
+		error += twiceMinor;
+		if (error >= twiceCount) {
+			error -= twiceCount;
+			minor += minorStep;
+		}
+	}
+}
+
+void Rasterizer::DrawWu(CImg<unsigned char>& image, float x0, float y0, float x1, float y1,
+	const unsigned char* color) {
+	bool steep = fabs(y1 - y0) > fabs(x1 - x0);
+	if (steep) {
+		swap(x0, y0);
+		swap(x1, y1);
+	}
+	if (x0 > x1) {
+		swap(x0, x1);
+		swap(y0, y1);
+	}
+	int majorLimit = steep ? image.height() : image.width();
+	int minorLimit = steep ? image.width() : image.height();
+	float dx = x1 - x0;
+	float gradient = dx == 0.0f ? 1.0f : (y1 - y0) / dx;
+
+	auto plot = [&](int major, int minor, float alpha) {
+		if (steep) {
+			Blend(image, minor, major, alpha, color);
+		}
+		else {
+			Blend(image, major, minor, alpha, color);
+		}
+	};
+
+	// Endpoints are covered by the part of their pixel the line spans.
+	float xEnd = floor(x0 + 0.5f);
+	float yEnd = y0 + gradient * (xEnd - x0);
+	float gap = 1.0f - (x0 + 0.5f - floor(x0 + 0.5f));
+	int first = (int)xEnd;
+	float yFloor = floor(yEnd);
+	plot(first, (int)yFloor, (1.0f - (yEnd - yFloor)) * gap);
+	plot(first, (int)yFloor + 1, (yEnd - yFloor) * gap);
+
+	xEnd = floor(x1 + 0.5f);
+	yEnd = y1 + gradient * (xEnd - x1);
+	gap = x1 + 0.5f - floor(x1 + 0.5f);
+	int last = (int)xEnd;
+	yFloor = floor(yEnd);
+	plot(last, (int)yFloor, (1.0f - (yEnd - yFloor)) * gap);
+	plot(last, (int)yFloor + 1, (yEnd - yFloor) * gap);
+
+	// Inner pixels, restricted to columns where the line is near the image.
+	float begin = max((float)(first + 1), 0.0f);
+	float end = min((float)(last - 1), (float)(majorLimit - 1));
+	if (gradient != 0.0f) {
+		float enter = x0 + (-1.0f - y0) / gradient;
+		float leave = x0 + (minorLimit - y0) / gradient;
+		begin = max(begin, floor(min(enter, leave)));
+		end = min(end, ceil(max(enter, leave)));
+	}
+	else if (y0 < -1.0f || y0 > minorLimit) {
+		return;
+	}
+	// Nearly flat lines beside the image put enter and leave far outside
+	// int; compare and clamp as floats before converting.
+	if (!(begin <= end)) {
+		return;
+	}
+	begin = min(max(begin, 0.0f), (float)(majorLimit - 1));
+	end = min(max(end, 0.0f), (float)(majorLimit - 1));
+	for (int x = (int)begin; x <= (int)end; x++) {
+		float y = y0 + gradient * (x - x0);
+		float row = floor(y);
+		float fraction = y - row;
+		plot(x, (int)row, 1.0f - fraction);
+		plot(x, (int)row + 1, fraction);
+	}
+}
+
+void Rasterizer::Blend(CImg<unsigned char>& image, int x, int y, float alpha, const unsigned char* color) {
+	if (x < 0 || y < 0 || x >= image.width() || y >= image.height()) {
+		return;
+	}
+	int channels = min(image.spectrum(), 3);
+	for (int c = 0; c < channels; c++) {
+		unsigned char* pixel = image.data(x, y, 0, c);
+		*pixel = (unsigned char)(*pixel * (1.0f - alpha) + color[c] * alpha + 0.5f);
+	}
+}
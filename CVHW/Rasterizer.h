@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include "CImg.h"
+using namespace cimg_library;
+
+// Filled circle marker. Pixel (w, h) belongs to it when its distance to
+// (x, y) is at most r.
+struct Circle {
+	float x, y, r;
+	unsigned char color[3];
+};
+
+// Line segment from (x0, y0) to (x1, y1).
+struct Segment {
+	float x0, y0, x1, y1;
+	unsigned char color[3];
+};
+
+struct Vertex {
+	float x, y;
+};
+
+// Span based rasterizer writing straight into the planes of a CImg. Every
+// shape is reduced to one run of pixels per row, which is then filled with
+// memset in each channel plane, clipped to the image.
+class Rasterizer {
+public:
+	// Rows per bucket of DrawCircles().
+	static const int BAND_HEIGHT = 32;
+
+	// Draws a filled circle. Only the first three channels are written.
+	static void DrawCircle(CImg<unsigned char>& image, float x, float y, float r,
+		const unsigned char* color);
+
+	// Draws many circles in one pass. Circles are sorted into buckets of
+	// BAND_HEIGHT rows, then every band is filled at once while it is in
+	// cache, by several threads (threadCount 0 means one per core). Where
+	// circles overlap, later ones are drawn over earlier ones, exactly as
+	// by calling DrawCircle() for each of them in order.
+	static void DrawCircles(CImg<unsigned char>& image, const std::vector<Circle>& circles,
+		int threadCount = 0);
+
+	// Draws a line between pixel centers. Aliased lines are integer
+	// Bresenham lines between the rounded endpoints; antialiased lines are
+	// Xiaolin Wu lines blended over the image. Both are clipped to the
+	// image analytically, so only visible pixels are visited, and clipping
+	// never changes which pixels a line covers.
+	static void DrawLine(CImg<unsigned char>& image, float x0, float y0, float x1, float y1,
+		const unsigned char* color, bool antialiased = false);
+
+	// Draws consecutive vertices connected by lines, and the last vertex
+	// connected to the first one if closed.
+	static void DrawPolyline(CImg<unsigned char>& image, const std::vector<Vertex>& vertices,
+		const unsigned char* color, bool closed = false, bool antialiased = false);
+
+	// Draws all segments in order.
+	static void DrawSegments(CImg<unsigned char>& image, const std::vector<Segment>& segments,
+		bool antialiased = false);
+
+private:
+	// Draws rows [rowBegin, rowEnd) of the circle; rows must be inside the
+	// image.
+	static void FillCircleRows(CImg<unsigned char>& image, const Circle& circle, int rowBegin, int rowEnd);
+
+	// Rows the circle covers, clipped to the image. False if it misses the
+	// image.
+	static bool CircleRows(const Circle& circle, int width, int height, int& rowBegin, int& rowEnd);
+
+	static void FillSpan(CImg<unsigned char>& image, int row, int left, int right, const unsigned char* color);
+
+	static void DrawBresenham(CImg<unsigned char>& image, int x0, int y0, int x1, int y1,
+		const unsigned char* color);
+
+	// Bresenham line given along its major axis: pixel i is at
+	// major0 + majorStep * i, minor0 + minorStep * k(i) for i in [0, count],
+	// where k(i) = floor((2 * minorCount * i + count) / (2 * count)).
+	// Calls plot(major, minor) for the pixels inside [0, majorLimit) x
+	// [0, minorLimit).
+	template<typename F>
+	static void WalkBresenham(int major0, int minor0, int majorStep, int minorStep, int count, int minorCount,
+		int majorLimit, int minorLimit, F plot);
+
+	static void DrawWu(CImg<unsigned char>& image, float x0, float y0, float x1, float y1,
+		const unsigned char* color);
+
+	// Blends color over pixel (x, y) with coverage alpha in [0, 1]; pixels
+	// outside the image are skipped.
+	static void Blend(CImg<unsigned char>& image, int x, int y, float alpha, const unsigned char* color);
+};
@@ -0,0 +1,230 @@
+#include <cmath>
+#include "RemapTable.h"
+using namespace std;
+
+RemapTable::RemapTable(const AffineTransform& transform, int sourceWidth, int sourceHeight,
+	int width, int height, Interpolation interpolation, int threadCount) {
+	this->transform = transform;
+	this->sourceWidth = sourceWidth;
+	this->sourceHeight = sourceHeight;
+	this->width = width;
+	this->height = height;
+	this->interpolation = interpolation;
+	entries.resize((size_t)width * height);
+
+	RotationEngine::ParallelFor(height, threadCount, 16, [this](int rowBegin, int rowEnd) {
+		BuildRows(rowBegin, rowEnd);
+	});
+}
+
+void RemapTable::BuildRows(int rowBegin, int rowEnd) {
+	bool bilinear = (interpolation == Interpolation::Bilinear);
+
+	for (int h = rowBegin; h < rowEnd; h++) {
+		float rowX = transform.b * h + transform.c;
+		float rowY = transform.e * h + transform.f;
+		RemapEntry* entry = &entries[(size_t)h * width];
+
+		for (int w = 0; w < width; w++, entry++) {
+			float x = rowX + transform.a * w;
+			float y = rowY + transform.d * w;
+			entry->reserved = 0;
+
+			if (!bilinear) {
+				int sx = (int)floor(x + 0.5f);
+				int sy = (int)floor(y + 0.5f);
+				bool inside = (sx >= 0 && sx < sourceWidth && sy >= 0 && sy < sourceHeight);
+				entry->offset = inside ? sy * sourceWidth + sx : 0;
+				entry->weightX = 0;
+				entry->weightY = 0;
+				entry->taps = inside ? 1 : 0;
+				continue;
+			}
+
+			// Far outside points would overflow the offset.
+			if (!(x > -1.0f && x < sourceWidth && y > -1.0f && y < sourceHeight)) {
+				entry->offset = 0;
+				entry->weightX = 0;
+				entry->weightY = 0;
+				entry->taps = 0;
+				continue;
+			}
+
+			// Round to 1/256 first and split afterwards, so a fraction rounding
+			// up to 1 moves to the next pixel with weight 0 instead of being
+			// clamped below 256. Both are shifted by one pixel to stay positive.
+			int fixedX = (int)floor(x * 256.0f + 0.5f) + 256;
+			int fixedY = (int)floor(y * 256.0f + 0.5f) + 256;
+			int x0 = (fixedX >> 8) - 1;
+			int y0 = (fixedY >> 8) - 1;
+			entry->offset = y0 * sourceWidth + x0;
+			entry->weightX = (unsigned char)(fixedX & 255);
+			entry->weightY = (unsigned char)(fixedY & 255);
+			bool left = (x0 >= 0 && x0 < sourceWidth);
+			bool right = (x0 + 1 >= 0 && x0 + 1 < sourceWidth);
+			bool top = (y0 >= 0 && y0 < sourceHeight);
+			bool bottom = (y0 + 1 >= 0 && y0 + 1 < sourceHeight);
+			entry->taps = (unsigned char)((left && top ? 1 : 0) | (right && top ? 2 : 0) |
+				(left && bottom ? 4 : 0) | (right && bottom ? 8 : 0));
+		}
+	}
+}
+
+bool RemapTable::Apply(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+	int threadCount) const {
+	if (source.width() != sourceWidth || source.height() != sourceHeight ||
+		source.depth() != 1 || source.spectrum() < 1) {
+		return false;
+	}
+	if (destination.width() != width || destination.height() != height ||
+		destination.depth() != 1 || destination.spectrum() != source.spectrum()) {
+		destination.assign(width, height, 1, source.spectrum());
+	}
+
+	RotationEngine::ParallelFor(height, threadCount, 16, [&](int rowBegin, int rowEnd) {
+		ApplyRows(source, destination, rowBegin, rowEnd);
+	});
+	return true;
+}
+
+void RemapTable::ApplyRows(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+	int rowBegin, int rowEnd) const {
+	int stride = sourceWidth;
+
+	for (int c = 0; c < source.spectrum(); c++) {
+		const unsigned char* plane = source.data(0, 0, 0, c);
+
+		for (int h = rowBegin; h < rowEnd; h++) {
+			const RemapEntry* entry = &entries[(size_t)h * width];
+			unsigned char* row = destination.data(0, h, 0, c);
+
+			if (interpolation == Interpolation::Nearest) {
+				for (int w = 0; w < width; w++) {
+					row[w] = entry[w].taps ? plane[entry[w].offset] : 0;
+				}
+				continue;
+			}
+
+			for (int w = 0; w < width; w++) {
+				const RemapEntry& e = entry[w];
+				const unsigned char* p = plane + e.offset;
+				unsigned int p00, p01, p10, p11;
+				if (e.taps == ALL_TAPS) {
+					p00 = p[0];
+					p01 = p[1];
+					p10 = p[stride];
+					p11 = p[stride + 1];
+				}
+				else {
+					// Missing pixels are black.
+					p00 = (e.taps & 1) ? p[0] : 0;
+					p01 = (e.taps & 2) ? p[1] : 0;
+					p10 = (e.taps & 4) ? p[stride] : 0;
+					p11 = (e.taps & 8) ? p[stride + 1] : 0;
+				}
+				unsigned int wx = e.weightX;
+				unsigned int wy = e.weightY;
+				unsigned int top = p00 * (256 - wx) + p01 * wx;
+				unsigned int bottom = p10 * (256 - wx) + p11 * wx;
+				row[w] = (unsigned char)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+			}
+		}
+	}
+}
+
+int RemapTable::Width() const {
+	return width;
+}
+
+int RemapTable::Height() const {
+	return height;
+}
+
+int RemapTable::SourceWidth() const {
+	return sourceWidth;
+}
+
+int RemapTable::SourceHeight() const {
+	return sourceHeight;
+}
+
+Interpolation RemapTable::GetInterpolation() const {
+	return interpolation;
+}
+
+const AffineTransform& RemapTable::Transform() const {
+	return transform;
+}
+
+size_t RemapTable::Bytes() const {
+	return entries.size() * sizeof(RemapEntry);
+}
+
+RemapCache::RemapCache(size_t capacity) {
+	this->capacity = max(capacity, (size_t)1);
+}
+
+shared_ptr<const RemapTable> RemapCache::Get(const AffineTransform& transform, int sourceWidth,
+	int sourceHeight, int width, int height, Interpolation interpolation) {
+	{
+		lock_guard<std::mutex> lock(mutex);
+		shared_ptr<const RemapTable> table = Find(transform, sourceWidth, sourceHeight, width, height,
+			interpolation);
+		if (table) {
+			return table;
+		}
+	}
+
+	// Building runs several threads, so other callers must not wait for it.
+	// Another thread may build the same table meanwhile; the first one
+	// inserted wins and the other is dropped.
+	shared_ptr<const RemapTable> built = make_shared<RemapTable>(transform, sourceWidth, sourceHeight,
+		width, height, interpolation);
+
+	lock_guard<std::mutex> lock(mutex);
+	shared_ptr<const RemapTable> table = Find(transform, sourceWidth, sourceHeight, width, height,
+		interpolation);
+	if (table) {
+		return table;
+	}
+	tables.push_front(built);
+	if (tables.size() > capacity) {
+		tables.pop_back();
+	}
+	return built;
+}
+
+shared_ptr<const RemapTable> RemapCache::Find(const AffineTransform& transform, int sourceWidth,
+	int sourceHeight, int width, int height, Interpolation interpolation) {
+	for (list<shared_ptr<const RemapTable> >::iterator i = tables.begin(); i != tables.end(); i++) {
+		const RemapTable& table = **i;
+		const AffineTransform& t = table.Transform();
+		if (table.SourceWidth() == sourceWidth && table.SourceHeight() == sourceHeight &&
+			table.Width() == width && table.Height() == height &&
+			table.GetInterpolation() == interpolation &&
+			t.a == transform.a && t.b == transform.b && t.c == transform.c &&
+			t.d == transform.d && t.e == transform.e && t.f == transform.f) {
+			tables.splice(tables.begin(), tables, i);
+			return tables.front();
+		}
+	}
+	return shared_ptr<const RemapTable>();
+}
+
+shared_ptr<const RemapTable> RemapCache::GetRotation(float angle, int sourceWidth, int sourceHeight,
+	Interpolation interpolation) {
+	int width, height;
+	RotationEngine::RotatedSize(sourceWidth, sourceHeight, angle, width, height);
+	return Get(RotationEngine::InverseRotation(sourceWidth, sourceHeight, angle),
+		sourceWidth, sourceHeight, width, height, interpolation);
+}
+
+void RemapCache::Clear() {
+	lock_guard<std::mutex> lock(mutex);
+	tables.clear();
+}
+
+size_t RemapCache::Size() {
+	lock_guard<std::mutex> lock(mutex);
+	return tables.size();
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "CImg.h"
+#include "RotationEngine.h"
+using namespace cimg_library;
+
+// One destination pixel of a remap table. Offset is the index of the upper
+// left sampled source pixel in a plane; it is only dereferenced together
+// with a set bit of taps, so it may point outside the plane on borders.
+struct RemapEntry {
+	int offset;
+	// Bilinear weights of the right and lower neighbours, in 1/256. The
+	// left and upper neighbours get the rest of 256.
+	unsigned char weightX;
+	unsigned char weightY;
+	// Bit 0: upper left, 1: upper right, 2: lower left, 3: lower right
+	// source pixel exists. 0 means the pixel is outside the source.
+	unsigned char taps;
+	unsigned char reserved;
+};
+
+// Precomputed geometric mapping of a warp. Building the table costs about
+// as much as one warp; applying it only gathers and blends, without any
+// coordinate arithmetic, so it pays off for every following frame.
+class RemapTable {
+public:
+	static const unsigned char ALL_TAPS = 15;
+
+	RemapTable(const AffineTransform& transform, int sourceWidth, int sourceHeight,
+		int width, int height, Interpolation interpolation, int threadCount = 0);
+
+	// Warps source into destination. Returns false, leaving destination
+	// untouched, if source is not a 2D image of the size the table was built
+	// for; destination is resized only if its size differs.
+	bool Apply(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+		int threadCount = 0) const;
+
+	int Width() const;
+	int Height() const;
+	int SourceWidth() const;
+	int SourceHeight() const;
+	Interpolation GetInterpolation() const;
+	const AffineTransform& Transform() const;
+	size_t Bytes() const;
+
+private:
+	void BuildRows(int rowBegin, int rowEnd);
+	void ApplyRows(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+		int rowBegin, int rowEnd) const;
+
+	AffineTransform transform;
+	int sourceWidth;
+	int sourceHeight;
+	int width;
+	int height;
+	Interpolation interpolation;
+	std::vector<RemapEntry> entries;
+};
+
+// Least recently used cache of remap tables, safe to use from several
+// threads. Tables are shared, so one returned earlier stays valid even
+// after it is evicted.
+class RemapCache {
+public:
+	explicit RemapCache(size_t capacity = 8);
+
+	std::shared_ptr<const RemapTable> Get(const AffineTransform& transform, int sourceWidth,
+		int sourceHeight, int width, int height, Interpolation interpolation);
+
+	// Table of RotationEngine::Rotate for the given angle and source size.
+	std::shared_ptr<const RemapTable> GetRotation(float angle, int sourceWidth, int sourceHeight,
+		Interpolation interpolation);
+
+	void Clear();
+	size_t Size();
+
+private:
+	// Matching table moved to the front, or null. Mutex must be held.
+	std::shared_ptr<const RemapTable> Find(const AffineTransform& transform, int sourceWidth,
+		int sourceHeight, int width, int height, Interpolation interpolation);
+
+	size_t capacity;
+	std::mutex mutex;
+	// Most recently used first.
+	std::list<std::shared_ptr<const RemapTable> > tables;
+};
@@ -0,0 +1,487 @@
+#include <cmath>
+#include <cstring>
+#include "RotationEngine.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROTATION_ENGINE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Interior spans are shrunk by this distance (in source pixels), so that
+// rounding differences between span computation and sampling can never
+// produce an index outside the source.
+static const float SPAN_MARGIN = 1.0f / 256.0f;
+
+// Steps below this are treated as constant by Span().
+static const float SPAN_EPSILON = 1e-6f;
+
+static const float PI = 3.1415926f;
+
+void RotationEngine::RotatedSize(int width, int height, float angle, int& newWidth, int& newHeight) {
+	float radians = (angle / 180.0f) * PI;
+	float cosine = cos(radians);
+	float sine = sin(radians);
+	float centerX = (float)(width / 2);
+	float centerY = (float)(height / 2);
+	float xs[] = { 0.0f, (float)(width - 1), 0.0f, (float)(width - 1) };
+	float ys[] = { 0.0f, 0.0f, (float)(height - 1), (float)(height - 1) };
+
+	float left = xs[0], right = xs[0], top = ys[0], bottom = ys[0];
+	for (int i = 0; i < 4; i++) {
+		float x = (xs[i] - centerX) * cosine - (ys[i] - centerY) * sine + centerX;
+		float y = (xs[i] - centerX) * sine + (ys[i] - centerY) * cosine + centerY;
+		if (i == 0) {
+			left = right = x;
+			top = bottom = y;
+		}
+		left = min(left, x);
+		right = max(right, x);
+		top = min(top, y);
+		bottom = max(bottom, y);
+	}
+	newWidth = (int)ceil(right - left + 1.0f);
+	newHeight = (int)ceil(bottom - top + 1.0f);
+}
+
+AffineTransform RotationEngine::InverseRotation(int width, int height, float angle) {
+	int newWidth, newHeight;
+	RotatedSize(width, height, angle, newWidth, newHeight);
+
+	float radians = (angle / 180.0f) * PI;
+	float cosine = cos(radians);
+	float sine = sin(radians);
+	float centerX = (float)(width / 2);
+	float centerY = (float)(height / 2);
+	// Rotated image is centered in the larger destination.
+	float deltaX = (newWidth - width) / 2.0f;
+	float deltaY = (newHeight - height) / 2.0f;
+	float originX = deltaX + centerX;
+	float originY = deltaY + centerY;
+
+	AffineTransform transform;
+	transform.a = cosine;
+	transform.b = sine;
+	transform.c = centerX - cosine * originX - sine * originY;
+	transform.d = -sine;
+	transform.e = cosine;
+	transform.f = centerY + sine * originX - cosine * originY;
+	return transform;
+}
+
+void RotationEngine::Rotate(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+	float angle, Interpolation interpolation, int threadCount) {
+	int newWidth, newHeight;
+	RotatedSize(source.width(), source.height(), angle, newWidth, newHeight);
+	if (destination.width() != newWidth || destination.height() != newHeight ||
+		destination.depth() != 1 || destination.spectrum() != source.spectrum()) {
+		destination.assign(newWidth, newHeight, 1, source.spectrum());
+	}
+
+	Warp(source, destination, InverseRotation(source.width(), source.height(), angle),
+		interpolation, threadCount);
+}
+
+void RotationEngine::Warp(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+	const AffineTransform& transform, Interpolation interpolation, int threadCount) {
+	ParallelFor(destination.height(), threadCount, 16, [&](int rowBegin, int rowEnd) {
+		WarpRows(source, destination, transform, interpolation, rowBegin, rowEnd);
+	});
+}
+
+void RotationEngine::Span(float start, float step, float low, float high, int count, int& begin, int& end) {
+	// Nearly constant rows (90 and 270 degrees) would overflow the division
+	// below; such a row is inside entirely or not at all.
+	if (fabs(step) < SPAN_EPSILON) {
+		float last = start + step * (count - 1);
+		bool inside = start >= low && start <= high && last >= low && last <= high;
+		begin = 0;
+		end = inside ? count : 0;
+		return;
+	}
+
+	float first = (low - start) / step;
+	float last = (high - start) / step;
+	if (step < 0.0f) {
+		swap(first, last);
+	}
+	// Clamp before converting, so the casts never overflow.
+	first = min(max(first, -1.0f), (float)count + 1.0f);
+	last = min(max(last, -1.0f), (float)count + 1.0f);
+	begin = max(0, (int)ceil(first));
+	end = min(count, (int)floor(last) + 1);
+
+	// Division may be off by one ulp; interior must never be too wide.
+	while (begin < end && !(start + step * begin >= low && start + step * begin <= high)) {
+		begin++;
+	}
+	while (end > begin && !(start + step * (end - 1) >= low && start + step * (end - 1) <= high)) {
+		end--;
+	}
+}
+
+unsigned char RotationEngine::SampleBilinear(const unsigned char* plane, int width, int height,
+	float x, float y) {
+	int x0 = (int)floor(x);
+	int y0 = (int)floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	// Pixels outside the source are black.
+	float p[2][2];
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			int sx = x0 + j;
+			int sy = y0 + i;
+			p[i][j] = (sx >= 0 && sx < width && sy >= 0 && sy < height) ? plane[sy * width + sx] : 0.0f;
+		}
+	}
+	float top = p[0][0] + fx * (p[0][1] - p[0][0]);
+	float bottom = p[1][0] + fx * (p[1][1] - p[1][0]);
+	return (unsigned char)(top + fy * (bottom - top) + 0.5f);
+}
+
+void RotationEngine::WarpRows(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+	const AffineTransform& transform, Interpolation interpolation, int rowBegin, int rowEnd) {
+	int width = source.width();
+	int height = source.height();
+	int newWidth = destination.width();
+	int channels = min(source.spectrum(), destination.spectrum());
+	bool bilinear = (interpolation == Interpolation::Bilinear);
+
+	// Per-row offsets of sampled source pixels and bilinear weights.
+	vector<int> offsets(newWidth);
+	vector<float> weightsX(bilinear ? newWidth : 0);
+	vector<float> weightsY(bilinear ? newWidth : 0);
+
+	// Nearest sampling needs the rounded coordinate inside the source,
+	// bilinear needs also the right and lower neighbours.
+	float lowX = bilinear ? 0.0f : -0.5f;
+	float lowY = lowX;
+	float highX = bilinear ? width - 1.0f : width - 0.5f;
+	float highY = bilinear ? height - 1.0f : height - 0.5f;
+
+	for (int h = rowBegin; h < rowEnd; h++) {
+		float rowX = transform.b * h + transform.c;
+		float rowY = transform.e * h + transform.f;
+
+		int beginX, endX, beginY, endY;
+		Span(rowX, transform.a, lowX + SPAN_MARGIN, highX - SPAN_MARGIN, newWidth, beginX, endX);
+		Span(rowY, transform.d, lowY + SPAN_MARGIN, highY - SPAN_MARGIN, newWidth, beginY, endY);
+		int begin = max(beginX, beginY);
+		int end = min(endX, endY);
+		if (begin >= end) {
+			begin = end = 0;
+		}
+
+		// Interior coordinates, shared by all channels.
+		int w = begin;
+#ifdef ROTATION_ENGINE_SSE2
+		__m128 stepX = _mm_set1_ps(transform.a);
+		__m128 stepY = _mm_set1_ps(transform.d);
+		__m128 startX = _mm_set1_ps(rowX);
+		__m128 startY = _mm_set1_ps(rowY);
+		__m128 half = _mm_set1_ps(bilinear ? 0.0f : 0.5f);
+		for (; w + 4 <= end; w += 4) {
+			__m128 index = _mm_add_ps(_mm_set1_ps((float)w), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+			__m128 x = _mm_add_ps(startX, _mm_mul_ps(stepX, index));
+			__m128 y = _mm_add_ps(startY, _mm_mul_ps(stepY, index));
+			// Coordinates are not negative here, so truncation is floor.
+			__m128i x0 = _mm_cvttps_epi32(_mm_add_ps(x, half));
+			__m128i y0 = _mm_cvttps_epi32(_mm_add_ps(y, half));
+			int xs[4], ys[4];
+			_mm_storeu_si128((__m128i*)xs, x0);
+			_mm_storeu_si128((__m128i*)ys, y0);
+			for (int i = 0; i < 4; i++) {
+				offsets[w + i] = ys[i] * width + xs[i];
+			}
+			if (bilinear) {
+				_mm_storeu_ps(&weightsX[w], _mm_sub_ps(x, _mm_cvtepi32_ps(x0)));
+				_mm_storeu_ps(&weightsY[w], _mm_sub_ps(y, _mm_cvtepi32_ps(y0)));
+			}
+		}
+#endif
+		for (; w < end; w++) {
+			float x = rowX + transform.a * w;
+			float y = rowY + transform.d * w;
+			if (bilinear) {
+				int x0 = (int)x;
+				int y0 = (int)y;
+				offsets[w] = y0 * width + x0;
+				weightsX[w] = x - x0;
+				weightsY[w] = y - y0;
+			}
+			else {
+				offsets[w] = (int)(y + 0.5f) * width + (int)(x + 0.5f);
+			}
+		}
+
+		for (int c = 0; c < channels; c++) {
+			const unsigned char* plane = source.data(0, 0, 0, c);
+			unsigned char* row = destination.data(0, h, 0, c);
+
+			// Border spans, checked sampling.
+			for (int part = 0; part < 2; part++) {
+				int spanBegin = (part == 0) ? 0 : end;
+				int spanEnd = (part == 0) ? begin : newWidth;
+				for (int i = spanBegin; i < spanEnd; i++) {
+					float x = rowX + transform.a * i;
+					float y = rowY + transform.d * i;
+					if (bilinear) {
+						row[i] = SampleBilinear(plane, width, height, x, y);
+					}
+					else {
+						int sx = (int)floor(x + 0.5f);
+						int sy = (int)floor(y + 0.5f);
+						row[i] = (sx >= 0 && sx < width && sy >= 0 && sy < height) ? plane[sy * width + sx] : 0;
+					}
+				}
+			}
+
+			// Interior span, no bounds checks.
+			if (!bilinear) {
+				for (int i = begin; i < end; i++) {
+					row[i] = plane[offsets[i]];
+				}
+				continue;
+			}
+
+			int i = begin;
+#ifdef ROTATION_ENGINE_SSE2
+			for (; i + 4 <= end; i += 4) {
+				const int* o = &offsets[i];
+				__m128 p00 = _mm_set_ps(plane[o[3]], plane[o[2]], plane[o[1]], plane[o[0]]);
+				__m128 p01 = _mm_set_ps(plane[o[3] + 1], plane[o[2] + 1], plane[o[1] + 1], plane[o[0] + 1]);
+				__m128 p10 = _mm_set_ps(plane[o[3] + width], plane[o[2] + width],
+					plane[o[1] + width], plane[o[0] + width]);
+				__m128 p11 = _mm_set_ps(plane[o[3] + width + 1], plane[o[2] + width + 1],
+					plane[o[1] + width + 1], plane[o[0] + width + 1]);
+				__m128 fx = _mm_loadu_ps(&weightsX[i]);
+				__m128 fy = _mm_loadu_ps(&weightsY[i]);
+				__m128 top = _mm_add_ps(p00, _mm_mul_ps(fx, _mm_sub_ps(p01, p00)));
+				__m128 bottom = _mm_add_ps(p10, _mm_mul_ps(fx, _mm_sub_ps(p11, p10)));
+				__m128 value = _mm_add_ps(top, _mm_mul_ps(fy, _mm_sub_ps(bottom, top)));
+				__m128i packed = _mm_cvttps_epi32(_mm_add_ps(value, _mm_set1_ps(0.5f)));
+				packed = _mm_packs_epi32(packed, packed);
+				packed = _mm_packus_epi16(packed, packed);
+				int bytes = _mm_cvtsi128_si32(packed);
+				memcpy(row + i, &bytes, 4);
+			}
+#endif
+			for (; i < end; i++) {
+				int o = offsets[i];
+				float fx = weightsX[i];
+				float top = plane[o] + fx * (plane[o + 1] - plane[o]);
+				float bottom = plane[o + width] + fx * (plane[o + width + 1] - plane[o + width]);
+				row[i] = (unsigned char)(top + weightsY[i] * (bottom - top) + 0.5f);
+			}
+		}
+	}
+}
+
+void RotationEngine::RotateThreeShear(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+	float angle, int threadCount) {
+	int width = source.width();
+	int height = source.height();
+	int channels = source.spectrum();
+	int newWidth, newHeight;
+	RotatedSize(width, height, angle, newWidth, newHeight);
+	if (destination.width() != newWidth || destination.height() != newHeight ||
+		destination.depth() != 1 || destination.spectrum() != channels) {
+		destination.assign(newWidth, newHeight, 1, channels);
+	}
+
+	// Shears are only accurate for small angles, so exact quarter turns
+	// reduce the rest of the rotation to [-45, 45] degrees.
+	int quarter = (int)floor(angle / 90.0f + 0.5f);
+	float residual = ((angle - 90.0f * quarter) / 180.0f) * PI;
+	quarter = ((quarter % 4) + 4) % 4;
+
+	CImg<unsigned char> turned;
+	int turnedX, turnedY;
+	QuarterTurn(source, turned, quarter, turnedX, turnedY, threadCount);
+	const CImg<unsigned char>& first = (quarter == 0) ? source : turned;
+	int firstWidth = first.width();
+	int firstHeight = first.height();
+
+	// Rotation = shear x by alpha, shear y by beta, shear x by alpha.
+	float alpha = -tan(residual / 2.0f);
+	float beta = sin(residual);
+
+	// Extent of the image after each shear, relative to the center.
+	float minU = 0.0f, maxU = 0.0f, minW = 0.0f, maxW = 0.0f;
+	for (int i = 0; i < 4; i++) {
+		float x = (i & 1) ? firstWidth - 1.0f - turnedX : -(float)turnedX;
+		float y = (i & 2) ? firstHeight - 1.0f - turnedY : -(float)turnedY;
+		float u = x + alpha * y;
+		float w = y + beta * u;
+		minU = (i == 0) ? u : min(minU, u);
+		maxU = (i == 0) ? u : max(maxU, u);
+		minW = (i == 0) ? w : min(minW, w);
+		maxW = (i == 0) ? w : max(maxW, w);
+	}
+
+	// Destination is centered the same way as in InverseRotation().
+	float originX = width / 2 + (newWidth - width) / 2.0f;
+	float originY = height / 2 + (newHeight - height) / 2.0f;
+
+	// Column of the first intermediate image is u + offsetU. Row of the
+	// second one is w + originY + rowShift, an integer distance from the
+	// destination row, so the last pass only shifts rows.
+	int offsetU = 1 - (int)floor(minU);
+	int shearedWidth = (int)ceil(maxU) + offsetU + 2;
+	int rowShift = (int)ceil(-minW - originY) + 1;
+	float offsetW = originY + rowShift;
+	int shearedHeight = (int)ceil(maxW + offsetW) + 2;
+
+	CImg<unsigned char> horizontal(shearedWidth, firstHeight, 1, channels);
+	CImg<unsigned char> vertical(shearedWidth, shearedHeight, 1, channels);
+
+	for (int c = 0; c < channels; c++) {
+		// First pass, rows of the turned image.
+		ParallelFor(firstHeight, threadCount, 16, [&](int begin, int end) {
+			for (int j = begin; j < end; j++) {
+				float v = (float)(j - turnedY);
+				ShiftLine(first.data(0, j, 0, c), firstWidth, horizontal.data(0, j, 0, c), shearedWidth,
+					turnedX - offsetU - alpha * v);
+			}
+		});
+
+		// Second pass, columns. Neighbouring columns are shifted by almost
+		// the same distance, so bands of columns are walked row by row and
+		// read only a few neighbouring rows.
+		const int band = 64;
+		int bands = (shearedWidth + band - 1) / band;
+		ParallelFor(bands, threadCount, 1, [&](int begin, int end) {
+			int shifts[band];
+			int weights[band];
+			for (int b = begin; b < end; b++) {
+				int i0 = b * band;
+				int i1 = min(shearedWidth, i0 + band);
+				for (int i = i0; i < i1; i++) {
+					float shift = turnedY - offsetW - beta * (i - offsetU);
+					int whole = (int)floor(shift);
+					int weight = (int)((shift - whole) * 256.0f + 0.5f);
+					if (weight == 256) {
+						whole++;
+						weight = 0;
+					}
+					shifts[i - i0] = whole;
+					weights[i - i0] = weight;
+				}
+				for (int k = 0; k < shearedHeight; k++) {
+					unsigned char* out = vertical.data(0, k, 0, c);
+					for (int i = i0; i < i1; i++) {
+						int j = k + shifts[i - i0];
+						int p0 = (j >= 0 && j < firstHeight) ? horizontal(i, j, 0, c) : 0;
+						int p1 = (j + 1 >= 0 && j + 1 < firstHeight) ? horizontal(i, j + 1, 0, c) : 0;
+						out[i] = (unsigned char)((p0 * (256 - weights[i - i0]) + p1 * weights[i - i0] + 128) >> 8);
+					}
+				}
+			}
+		});
+
+		// Third pass, rows of the destination.
+		ParallelFor(newHeight, threadCount, 16, [&](int begin, int end) {
+			for (int h = begin; h < end; h++) {
+				int k = h + rowShift;
+				unsigned char* out = destination.data(0, h, 0, c);
+				if (k < 0 || k >= shearedHeight) {
+					memset(out, 0, newWidth);
+					continue;
+				}
+				ShiftLine(vertical.data(0, k, 0, c), shearedWidth, out, newWidth,
+					offsetU - originX - alpha * (h - originY));
+			}
+		});
+	}
+}
+
+void RotationEngine::QuarterTurn(const CImg<unsigned char>& source, CImg<unsigned char>& turned, int quarter,
+	int& centerX, int& centerY, int threadCount) {
+	int width = source.width();
+	int height = source.height();
+	int channels = source.spectrum();
+
+	if (quarter == 0) {
+		centerX = width / 2;
+		centerY = height / 2;
+		return;
+	}
+
+	bool odd = (quarter % 2 == 1);
+	int turnedWidth = odd ? height : width;
+	int turnedHeight = odd ? width : height;
+	if (quarter == 1) {
+		centerX = height - 1 - height / 2;
+		centerY = width / 2;
+	}
+	else if (quarter == 2) {
+		centerX = width - 1 - width / 2;
+		centerY = height - 1 - height / 2;
+	}
+	else {
+		centerX = height / 2;
+		centerY = width - 1 - width / 2;
+	}
+	turned.assign(turnedWidth, turnedHeight, 1, channels);
+
+	// Copied in square blocks, so that both images are accessed in cache
+	// friendly order.
+	const int block = 32;
+	int rows = (turnedHeight + block - 1) / block;
+	ParallelFor(rows, threadCount, 1, [&](int begin, int end) {
+		for (int c = 0; c < channels; c++) {
+			const unsigned char* plane = source.data(0, 0, 0, c);
+			for (int jb = begin * block; jb < min(turnedHeight, end * block); jb += block) {
+				for (int ib = 0; ib < turnedWidth; ib += block) {
+					for (int j = jb; j < min(turnedHeight, jb + block); j++) {
+						unsigned char* out = turned.data(0, j, 0, c);
+						for (int i = ib; i < min(turnedWidth, ib + block); i++) {
+							if (quarter == 1) {
+								out[i] = plane[(height - 1 - i) * width + j];
+							}
+							else if (quarter == 2) {
+								out[i] = plane[(height - 1 - j) * width + (width - 1 - i)];
+							}
+							else {
+								out[i] = plane[i * width + (width - 1 - j)];
+							}
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+void RotationEngine::ShiftLine(const unsigned char* in, int inCount, unsigned char* out, int outCount, float shift) {
+	// Shift is the same for the whole line, so are the weights.
+	int whole = (int)floor(shift);
+	int weight = (int)((shift - whole) * 256.0f + 0.5f);
+	if (weight == 256) {
+		whole++;
+		weight = 0;
+	}
+
+	// Both neighbours exist for i in [begin, end).
+	int begin = max(0, min(outCount, -whole));
+	int end = max(begin, min(outCount, inCount - 1 - whole));
+
+	for (int part = 0; part < 2; part++) {
+		int spanBegin = (part == 0) ? 0 : end;
+		int spanEnd = (part == 0) ? begin : outCount;
+		for (int i = spanBegin; i < spanEnd; i++) {
+			int j = i + whole;
+			int p0 = (j >= 0 && j < inCount) ? in[j] : 0;
+			int p1 = (j + 1 >= 0 && j + 1 < inCount) ? in[j + 1] : 0;
+			out[i] = (unsigned char)((p0 * (256 - weight) + p1 * weight + 128) >> 8);
+		}
+	}
+
+	const unsigned char* p = in + whole;
+	for (int i = begin; i < end; i++) {
+		out[i] = (unsigned char)((p[i] * (256 - weight) + p[i + 1] * weight + 128) >> 8);
+	}
+}
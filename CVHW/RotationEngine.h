@@ -0,0 +1,97 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "CImg.h"
+using namespace cimg_library;
+
+enum class Interpolation {
+	Nearest,
+	Bilinear
+};
+
+// Maps destination pixel (x, y) to source point
+// (a * x + b * y + c, d * x + e * y + f).
+struct AffineTransform {
+	float a, b, c;
+	float d, e, f;
+};
+
+// Backward-mapping warp engine. The inverse transform is computed once,
+// then every destination row is split into an interior span, where all
+// sampled source pixels exist and no bounds checks are needed, and border
+// spans on both sides. Rows are processed by several threads in bands.
+class RotationEngine {
+public:
+	// Size of the bounding box of the image rotated by angle (in degrees)
+	// around its center, the same as HW1Utils::RotateImage produces.
+	static void RotatedSize(int width, int height, float angle, int& newWidth, int& newHeight);
+
+	// Transform mapping pixels of the rotated image back into the source.
+	static AffineTransform InverseRotation(int width, int height, float angle);
+
+	// Rotates source into destination. Destination is resized to
+	// RotatedSize() only if its size differs, so a buffer reused between
+	// calls is never reallocated. Pixels outside the source are black.
+	// threadCount 0 means one thread per core.
+	static void Rotate(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+		float angle, Interpolation interpolation = Interpolation::Nearest, int threadCount = 0);
+
+	// Same geometry as Rotate() with bilinear sampling, computed as exact
+	// quarter turns followed by three shears (Paeth). Every shear is a 1D
+	// linear interpolation along rows or columns, so memory is streamed
+	// sequentially instead of gathered, which suits very large images.
+	static void RotateThreeShear(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+		float angle, int threadCount = 0);
+
+	// Fills whole destination (of its current size and source spectrum)
+	// by sampling source at transformed coordinates.
+	static void Warp(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+		const AffineTransform& transform, Interpolation interpolation = Interpolation::Nearest,
+		int threadCount = 0);
+
+	// Splits [0, count) into contiguous bands and runs function(begin, end)
+	// for each of them on its own thread.
+	template<typename F>
+	static void ParallelFor(int count, int threadCount, int minimalBand, F function);
+
+private:
+	static void WarpRows(const CImg<unsigned char>& source, CImg<unsigned char>& destination,
+		const AffineTransform& transform, Interpolation interpolation, int rowBegin, int rowEnd);
+
+	// Range [begin, end) of x where low <= start + step * x <= high, clipped
+	// to [0, count).
+	static void Span(float start, float step, float low, float high, int count, int& begin, int& end);
+
+	// Rotates by quarter * 90 degrees around (width / 2, height / 2). Pixel
+	// (i, j) of turned is the point (i - centerX, j - centerY) relative to
+	// the center of rotation.
+	static void QuarterTurn(const CImg<unsigned char>& source, CImg<unsigned char>& turned, int quarter,
+		int& centerX, int& centerY, int threadCount);
+
+	// out[i] = in at i + shift, linearly interpolated, black
+	// outside of in.
+	static void ShiftLine(const unsigned char* in, int inCount, unsigned char* out, int outCount, float shift);
+
+	static unsigned char SampleBilinear(const unsigned char* plane, int width, int height,
+		float x, float y);
+};
+
+template<typename F>
+void RotationEngine::ParallelFor(int count, int threadCount, int minimalBand, F function) {
+	if (threadCount <= 0) {
+		threadCount = (int)std::thread::hardware_concurrency();
+	}
+	threadCount = std::max(1, std::min(threadCount, count / std::max(minimalBand, 1)));
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; i++) {
+		int begin = (int)((long long)count * i / threadCount);
+		int end = (int)((long long)count * (i + 1) / threadCount);
+		threads.push_back(std::thread(function, begin, end));
+	}
+	function(0, (int)((long long)count / threadCount));
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+}
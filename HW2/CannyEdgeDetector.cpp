@@ -9,84 +9,185 @@
  */
 
 #include <math.h>
+#include <algorithm>
 #include "CImg.h"
 #include "CannyEdgeDetector.h"
 using namespace cimg_library;
 
+/*
+ * Sink used when none is set, ignores all metrics.
+ */
+static MetricsSink default_metrics_sink;
+
+/*
+ * Names of internal buffers, in order of `CannyEdgeDetector::Buffer`.
+ */
+static const char* BUFFER_NAMES[] = {
+	"workspace_bitmap", "blur_bitmap", "edge_map", "gaussian_mask",
+	"strong_bits", "weak_bits", "dirty_tiles"
+};
+
+/*
+ * Assigns count copies of value to vector and tells whether the vector
+ * had to allocate memory for it.
+ */
+template<typename T>
+static bool AssignVector(std::vector<T>& vector, size_t count, const T& value) {
+	size_t capacity = vector.capacity();
+	vector.assign(count, value);
+	return vector.capacity() != capacity;
+}
+
 CannyEdgeDetector::CannyEdgeDetector() {
 	width = (unsigned int)0;
 	height = (unsigned int)0;
 	x = (unsigned int)0;
 	y = (unsigned int)0;
 	mask_halfsize = (unsigned int)0;
+	tile_size = (unsigned int)0;
+	row_words = (unsigned int)0;
+	hysteresis_mode = HysteresisMode::Recursive;
+	metrics_sink = &default_metrics_sink;
+	bytes_read = 0;
+	bytes_written = 0;
+
+	metrics.allocations = 0;
+	metrics.allocated_bytes = 0;
+	metrics.current_bytes = 0;
+	metrics.peak_bytes = 0;
+	for (unsigned int i = 0; i < BUFFER_COUNT; i++) {
+		BufferMetrics buffer = { BUFFER_NAMES[i], 0, 0, 0 };
+		metrics.buffers.push_back(buffer);
+	}
 }
 
 CannyEdgeDetector::~CannyEdgeDetector() {
-	delete edge_magnitude;
-	delete edge_direction;
-	delete workspace_bitmap;
+}
+
+void CannyEdgeDetector::SetTileSize(unsigned int tileSize) {
+	this->tile_size = tileSize;
+}
+
+void CannyEdgeDetector::SetHysteresisMode(HysteresisMode mode) {
+	this->hysteresis_mode = mode;
+}
+
+void CannyEdgeDetector::SetMetricsSink(MetricsSink* sink) {
+	this->metrics_sink = sink != NULL ? sink : &default_metrics_sink;
+}
+
+const DetectorMetrics& CannyEdgeDetector::GetMetrics() const {
+	return this->metrics;
 }
 
 CImg<unsigned char>* CannyEdgeDetector::ProcessImage(CImg<unsigned char>* source_bitmap, unsigned int width,
 	unsigned int height, float sigma,
 	uint8_t lowThreshold, uint8_t highThreshold) {
 	/*
-	 * Setting up image width and height in pixels.
+	 * CImg stores image in planes (RRR...GGG...BBB...). Result is written
+	 * back to the source image.
 	 */
-	this->width = width;
-	this->height = height;
+	ImageView view = ImageView::FromCImg(source_bitmap);
+	view.width = width;
+	view.height = height;
 
+	this->ProcessImage(view, view, sigma, lowThreshold, highThreshold);
+
+	return source_bitmap;
+}
+
+void CannyEdgeDetector::ProcessImage(const ImageView& source, const ImageView& destination,
+	float sigma, uint8_t lowThreshold, uint8_t highThreshold) {
 	/*
-	 * We store image in array of bytes (chars) in BGR(BGRBGRBGR...) order.
-	 * Size of the table is width * height * 3 bytes.
+	 * Setting up image width and height in pixels.
 	 */
-	this->source_bitmap = source_bitmap;
+	this->width = source.width;
+	this->height = source.height;
 
 	/*
-	 * Conversion to grayscale. Only luminance information remains.
+	 * Source and destination are only accessed through views, so they may
+	 * be memory-mapped files, CImg planes or the same image.
 	 */
-	this->Luminance();
+	this->source_view = source;
+	this->destination_view = destination;
+	this->BeginMetrics();
 
 	/*
 	 * "Widening" image. At this step we already need to know the size of
 	 * gaussian mask.
 	 */
 	this->PreProcessImage(sigma);
+	this->FinishStage("PreProcessImage");
+
+	/*
+	 * Conversion to grayscale. Only luminance information remains.
+	 */
+	this->Luminance();
+	this->FinishStage("Luminance");
 
 	/*
 	 * Noise reduction - Gaussian filter.
 	 */
 	this->GaussianBlur(sigma);
+	this->FinishStage("GaussianBlur");
 
 	/*
 	 * Edge detection - Sobel filter.
 	 */
 	this->EdgeDetection();
+	this->FinishStage("EdgeDetection");
 
 	/*
 	 * Suppression of non maximum pixels.
 	 */
 	this->NonMaxSuppression();
+	this->FinishStage("NonMaxSuppression");
 
 	/*
 	 * Hysteresis thresholding.
 	 */
-	this->Hysteresis(lowThreshold, highThreshold);
+	if (this->hysteresis_mode == HysteresisMode::BitParallel) {
+		this->HysteresisBitParallel(lowThreshold, highThreshold);
+	}
+	else {
+		this->Hysteresis(lowThreshold, highThreshold);
+	}
+	this->FinishStage("Hysteresis");
 
 	/*
 	 * "Shrinking" image.
 	 */
 	this->PostProcessImage();
+	this->FinishStage("PostProcessImage");
 
-	return source_bitmap;
+	this->metrics_sink->Report(this->metrics);
+}
+
+void CannyEdgeDetector::GetEdgePoints(std::vector<EdgePoint>& points) {
+	if (this->edge_map.Size() == 0) {
+		return;
+	}
+
+	// Result is stored in the middle of enlarged workspace.
+	for (x = 0; x < height; x++) {
+		for (y = 0; y < width; y++) {
+			if (GetPixelValue(x + mask_halfsize, y + mask_halfsize) == 255) {
+				EdgePoint point;
+				point.x = x;
+				point.y = y;
+				point.direction = this->edge_map(x + mask_halfsize, y + mask_halfsize).direction;
+				points.push_back(point);
+			}
+		}
+	}
 }
 
 inline uint8_t CannyEdgeDetector::GetPixelValue(unsigned int x, unsigned int y) {
-	return this->workspace_bitmap->operator()(y, x, 0, 0);
+	return this->workspace_bitmap(x, y);
 }
 
 inline void CannyEdgeDetector::SetPixelValue(unsigned int x, unsigned int y, uint8_t value) {
-	this->workspace_bitmap->operator()(y, x, 0, 0) = value;
+	this->workspace_bitmap(x, y) = value;
 }
 
 void CannyEdgeDetector::PreProcessImage(float sigma) {
@@ -97,85 +198,23 @@ void CannyEdgeDetector::PreProcessImage(float sigma) {
 	// Enlarging workspace bitmap width and height.
 	height += mask_halfsize * 2;
 	width += mask_halfsize * 2;
-	// Working area.
-	this->workspace_bitmap = new CImg<unsigned char>(width, height, 1, 1);
-
-	// Edge information arrays.
-	this->edge_magnitude = new CImg<unsigned char>(width, height, 1, 1);
-	this->edge_direction = new CImg<unsigned char>(width, height, 1, 1);
 
-	// Zeroing direction array.
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			this->edge_direction->operator()(y, x, 0, 0) = 0;
-		}
-	}
-
-	// Copying image data into work area.
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			// Upper left corner.
-			if (x < mask_halfsize && y < mask_halfsize) {
-				SetPixelValue(x, y, this->source_bitmap->operator()(0, 0, 0, 0));
-			}
-			// Bottom left corner.
-			else if (x >= height - mask_halfsize && y < mask_halfsize) {
-				int rawIndex = (height - 2 * mask_halfsize - 1) * (width - 2 * mask_halfsize);
-				int row = rawIndex / width;
-				int column = rawIndex % width;
-				SetPixelValue(x, y, this->source_bitmap->operator()(column, row, 0, 0));
-			}
-			// Upper right corner.
-			else if (x < mask_halfsize && y >= width - mask_halfsize) {
-				int rawIndex = (width - 2 * mask_halfsize - 1);
-				int row = rawIndex / width;
-				int column = rawIndex % width;
-				SetPixelValue(x, y, this->source_bitmap->operator()(column, row, 0, 0));
-			}
-			// Bottom right corner.
-			else if (x >= height - mask_halfsize && y >= width - mask_halfsize) {
-				int rawIndex = (height - 2 * mask_halfsize - 1) * (width - 2 * mask_halfsize) + (width - 2 * mask_halfsize - 1);
-				int row = rawIndex / width;
-				int column = rawIndex % width;
-				SetPixelValue(x, y, this->source_bitmap->operator()(column, row, 0, 0));
-			}
-			// Upper beam.
-			else if (x < mask_halfsize) {
-				int rawIndex = (y - mask_halfsize);
-				int row = rawIndex / width;
-				int column = rawIndex % width;
-				SetPixelValue(x, y, this->source_bitmap->operator()(column, row, 0, 0));
-			}
-			// Bottom beam.
-			else if (x >= height - mask_halfsize) {
-				int rawIndex = (height - 2 * mask_halfsize - 1) * (width - 2 * mask_halfsize) + (y - mask_halfsize);
-				int row = rawIndex / width;
-				int column = rawIndex % width;
-				SetPixelValue(x, y, this->source_bitmap->operator()(column, row, 0, 0));
-			}
-			// Left beam.
-			else if (y < mask_halfsize) {
-				int rawIndex = (x - mask_halfsize) * (width - 2 * mask_halfsize);
-				int row = rawIndex / width;
-				int column = rawIndex % width;
-				SetPixelValue(x, y, this->source_bitmap->operator()(column, row, 0, 0));
-			}
-			// Right beam.
-			else if (y >= width - mask_halfsize) {
-				int rawIndex = (x - mask_halfsize) * (width - 2 * mask_halfsize) + (width - 2 * mask_halfsize - 1);
-				int row = rawIndex / width;
-				int column = rawIndex % width;
-				SetPixelValue(x, y, this->source_bitmap->operator()(column, row, 0, 0));
-			}
-			// The rest of the image.
-			else {
-				int rawIndex = (x - mask_halfsize) * (width - 2 * mask_halfsize) + (y - mask_halfsize);
-				int row = rawIndex / width;
-				int column = rawIndex % width;
-				SetPixelValue(x, y, this->source_bitmap->operator()(column, row, 0, 0));
-			}
-		}
-	}
+	// Working area and intermediate result of blur, both in the same
+	// layout, so that every stage walks them in memory order.
+	this->workspace_bitmap.Allocate(width, height, tile_size);
+	this->CountAllocation(BUFFER_WORKSPACE, workspace_bitmap.Bytes());
+	this->blur_bitmap.Allocate(width, height, tile_size);
+	this->CountAllocation(BUFFER_BLUR, blur_bitmap.Bytes());
+
+	// Edge information array, magnitude and direction of one pixel are
+	// stored next to each other.
+	this->edge_map.Allocate(width, height, tile_size);
+	this->CountAllocation(BUFFER_EDGE_MAP, edge_map.Bytes());
+
+	// Zeroing edge information.
+	EdgeSample zero = { 0, 0, 0 };
+	this->edge_map.Fill(zero);
+	bytes_written += edge_map.Size() * sizeof(EdgeSample);
 }
 
 void CannyEdgeDetector::PostProcessImage() {
@@ -184,139 +223,166 @@ void CannyEdgeDetector::PostProcessImage() {
 	width -= 2 * mask_halfsize;
 
 	// Shrinking image.
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			this->source_bitmap->operator()(y, x, 0, 0) = this->workspace_bitmap->operator()(y + mask_halfsize, x + mask_halfsize, 0, 0);
-			this->source_bitmap->operator()(y, x, 0, 1) = this->workspace_bitmap->operator()(y + mask_halfsize, x + mask_halfsize, 0, 0);
-			this->source_bitmap->operator()(y, x, 0, 2) = this->workspace_bitmap->operator()(y + mask_halfsize, x + mask_halfsize, 0, 0);
+	workspace_bitmap.ForEach(mask_halfsize, height + mask_halfsize, mask_halfsize, width + mask_halfsize,
+		[&](unsigned int x, unsigned int y) {
+		uint8_t value = GetPixelValue(x, y);
+		for (unsigned int c = 0; c < destination_view.channels; c++) {
+			destination_view.At(x - mask_halfsize, y - mask_halfsize, c) = value;
 		}
-	}
+	});
+	bytes_read += (size_t)width * height;
+	bytes_written += (size_t)width * height * destination_view.channels;
 }
 
 void CannyEdgeDetector::Luminance() {
-	unsigned long i;
-	float gray_value, blue_value, green_value, red_value;
+	// Copying image data into the middle of work area.
+	workspace_bitmap.ForEach(mask_halfsize, height - mask_halfsize, mask_halfsize, width - mask_halfsize,
+		[&](unsigned int x, unsigned int y) {
+		float gray_value, blue_value, green_value, red_value;
 
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			// The order of bytes is RGB.
-			red_value = this->source_bitmap->operator()(y, x, 0, 0);
-			green_value = this->source_bitmap->operator()(y, x, 0, 1);
-			blue_value = this->source_bitmap->operator()(y, x, 0, 2);
+		if (source_view.channels < 3) {
+			gray_value = source_view.At(x - mask_halfsize, y - mask_halfsize, 0);
+		}
+		else {
+			// The order of channels is RGB.
+			red_value = source_view.At(x - mask_halfsize, y - mask_halfsize, 0);
+			green_value = source_view.At(x - mask_halfsize, y - mask_halfsize, 1);
+			blue_value = source_view.At(x - mask_halfsize, y - mask_halfsize, 2);
 
 			// Standard equation from RGB to grayscale.
 			gray_value = (uint8_t)(0.299 * red_value + 0.587 * green_value + 0.114 * blue_value);
-
-			// Ultimately making picture grayscale.
-			this->source_bitmap->operator()(y, x, 0, 0) = gray_value;
-			this->source_bitmap->operator()(y, x, 0, 1) = gray_value;
-			this->source_bitmap->operator()(y, x, 0, 2) = gray_value;
 		}
-	}
+		SetPixelValue(x, y, gray_value);
+	});
+
+	// Margins repeat the nearest pixel of the image (outermost rows and
+	// columns, corners repeat corner pixels). Every margin rectangle is
+	// walked in memory order, only the middle of work area is read.
+	unsigned int first = mask_halfsize;
+	unsigned int last_x = height - 1 - mask_halfsize;
+	unsigned int last_y = width - 1 - mask_halfsize;
+	auto replicate = [&](unsigned int x, unsigned int y) {
+		unsigned int source_x = x < first ? first : (x > last_x ? last_x : x);
+		unsigned int source_y = y < first ? first : (y > last_y ? last_y : y);
+		SetPixelValue(x, y, GetPixelValue(source_x, source_y));
+	};
+	// Upper and bottom beams (with corners).
+	workspace_bitmap.ForEach(0, first, 0, width, replicate);
+	workspace_bitmap.ForEach(last_x + 1, height, 0, width, replicate);
+	// Left and right beams.
+	workspace_bitmap.ForEach(first, last_x + 1, 0, first, replicate);
+	workspace_bitmap.ForEach(first, last_x + 1, last_y + 1, width, replicate);
+
+	size_t inner = (size_t)(width - 2 * mask_halfsize) * (height - 2 * mask_halfsize);
+	size_t margins = (size_t)width * height - inner;
+	bytes_read += inner * (source_view.channels < 3 ? 1 : 3) + margins;
+	bytes_written += (size_t)width * height;
 }
 
 void CannyEdgeDetector::GaussianBlur(float sigma) {
 	// We already calculated mask size in PreProcessImage.
-	long signed_mask_halfsize = this->mask_halfsize;
-
-	CImg<unsigned char>* gaussianMask = new CImg<unsigned char>(mask_size, mask_size, 1, 1);
-
+	int signed_mask_halfsize = this->mask_halfsize;
+
+	// Gauss function is separable, so the image is blurred with 1D mask
+	// first along rows and then along columns. The mask is normalized, so
+	// that brightness of the image does not change.
+	// Mask is kept between calls, it is allocated only when it grows.
+	if (AssignVector(gaussian_mask, mask_size, 0.0f)) {
+		this->CountAllocation(BUFFER_GAUSSIAN_MASK, gaussian_mask.capacity() * sizeof(float));
+	}
+	float* gaussianMask = &gaussian_mask[0];
+	float sum = 0.0f;
 	for (int i = -signed_mask_halfsize; i <= signed_mask_halfsize; i++) {
-		for (int j = -signed_mask_halfsize; j <= signed_mask_halfsize; j++) {
-			gaussianMask->operator()(j + signed_mask_halfsize, i + signed_mask_halfsize, 0, 0)
-				= (1 / (2 * PI * sigma * sigma)) * exp(-(i * i + j * j) / (2 * sigma * sigma));
-		}
+		gaussianMask[i + signed_mask_halfsize] = exp(-(i * i) / (2 * sigma * sigma));
+		sum += gaussianMask[i + signed_mask_halfsize];
+	}
+	for (unsigned int i = 0; i < mask_size; i++) {
+		gaussianMask[i] /= sum;
 	}
 
-	unsigned long i;
-	unsigned long i_offset;
-	int row_offset;
-	int col_offset;
-	float new_pixel;
-
-	for (x = signed_mask_halfsize; x < height - signed_mask_halfsize; x++) {
-		for (y = signed_mask_halfsize; y < width - signed_mask_halfsize; y++) {
-			new_pixel = 0;
-			for (row_offset = -signed_mask_halfsize; row_offset <= signed_mask_halfsize; row_offset++) {
-				for (col_offset = -signed_mask_halfsize; col_offset <= signed_mask_halfsize; col_offset++) {
-					new_pixel += (float)(this->workspace_bitmap->operator()(y + col_offset, x + row_offset, 0, 0))
-						* gaussianMask->operator()(signed_mask_halfsize + col_offset, signed_mask_halfsize + row_offset, 0, 0);
-				}
-			}
-			i = (unsigned long)(x * width + y);
-			this->workspace_bitmap->operator()(y, x, 0, 0);
+	// Horizontal pass, margins are blurred too because vertical pass
+	// reads them.
+	blur_bitmap.ForEach(0, height, mask_halfsize, width - mask_halfsize,
+		[&](unsigned int x, unsigned int y) {
+		float new_pixel = 0.0f;
+		for (int offset = -signed_mask_halfsize; offset <= signed_mask_halfsize; offset++) {
+			new_pixel += GetPixelValue(x, y + offset) * gaussianMask[offset + signed_mask_halfsize];
 		}
-	}
-	delete gaussianMask;
+		blur_bitmap(x, y) = (uint8_t)(new_pixel + 0.5f);
+	});
+
+	// Vertical pass, back into working area.
+	workspace_bitmap.ForEach(mask_halfsize, height - mask_halfsize, mask_halfsize, width - mask_halfsize,
+		[&](unsigned int x, unsigned int y) {
+		float new_pixel = 0.0f;
+		for (int offset = -signed_mask_halfsize; offset <= signed_mask_halfsize; offset++) {
+			new_pixel += blur_bitmap(x + offset, y) * gaussianMask[offset + signed_mask_halfsize];
+		}
+		SetPixelValue(x, y, (uint8_t)(new_pixel + 0.5f));
+	});
+
+	size_t blurred = (size_t)height * (width - 2 * mask_halfsize);
+	bytes_read += (size_t)width * height + blurred;
+	bytes_written += blurred + (size_t)(height - 2 * mask_halfsize) * (width - 2 * mask_halfsize);
 }
 
 void CannyEdgeDetector::EdgeDetection() {
-	// Sobel masks.
-	float Gx[9];
-	Gx[0] = 1.0; Gx[1] = 0.0; Gx[2] = -1.0;
-	Gx[3] = 2.0; Gx[4] = 0.0; Gx[5] = -2.0;
-	Gx[6] = 1.0; Gx[7] = 0.0; Gx[8] = -1.0;
-	float Gy[9];
-	Gy[0] = -1.0; Gy[1] = -2.0; Gy[2] = -1.0;
-	Gy[3] = 0.0; Gy[4] = 0.0; Gy[5] = 0.0;
-	Gy[6] = 1.0; Gy[7] = 2.0; Gy[8] = 1.0;
-
-	float value_gx, value_gy;
-
 	float max = 0.0;
-	float angle = 0.0;
-
-	// Convolution.
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			value_gx = 0.0;
-			value_gy = 0.0;
-
-			for (int k = 0; k < 3; k++) {
-				for (int l = 0; l < 3; l++) {
-					value_gx += Gx[l * 3 + k] * GetPixelValue((x + 1) + (1 - k),
-						(y + 1) + (1 - l));
-					value_gy += Gy[l * 3 + k] * GetPixelValue((x + 1) + (1 - k),
-						(y + 1) + (1 - l));
-				}
-			}
-			this->edge_magnitude->operator()(y, x, 0 ,0) = sqrt(value_gx * value_gx + value_gy * value_gy) / 4.0;
 
-			// Maximum magnitude.
-			max = this->edge_magnitude->operator()(y, x, 0, 0) > max ? this->edge_magnitude->operator()(y, x, 0, 0) : max;
-
-			// Angle calculation.
-			if ((value_gx != 0.0) || (value_gy != 0.0)) {
-				angle = atan2(value_gy, value_gx) * 180.0 / PI;
-			}
-			else {
-				angle = 0.0;
-			}
-			if (((angle > -22.5) && (angle <= 22.5)) ||
-				((angle > 157.5) && (angle <= -157.5))) {
-				this->edge_direction->operator()(y, x, 0, 0) = 0;
-			}
-			else if (((angle > 22.5) && (angle <= 67.5)) ||
-				((angle > -157.5) && (angle <= -112.5))) {
-				this->edge_direction->operator()(y, x, 0, 0) = 45;
-			}
-			else if (((angle > 67.5) && (angle <= 112.5)) ||
-				((angle > -112.5) && (angle <= -67.5))) {
-				this->edge_direction->operator()(y, x, 0, 0) = 90;
-			}
-			else if (((angle > 112.5) && (angle <= 157.5)) ||
-				((angle > -67.5) && (angle <= -22.5))) {
-				this->edge_direction->operator()(y, x, 0, 0) = 135;
-			}
+	// Convolution with Sobel masks. Outermost pixels have no neighbours,
+	// their magnitude stays 0.
+	edge_map.ForEach(1, height - 1, 1, width - 1, [&](unsigned int x, unsigned int y) {
+		// Derivative along rows (x).
+		float value_gx =
+			(GetPixelValue(x + 1, y - 1) + 2.0f * GetPixelValue(x + 1, y) + GetPixelValue(x + 1, y + 1)) -
+			(GetPixelValue(x - 1, y - 1) + 2.0f * GetPixelValue(x - 1, y) + GetPixelValue(x - 1, y + 1));
+		// Derivative along columns (y), negated.
+		float value_gy =
+			(GetPixelValue(x - 1, y - 1) + 2.0f * GetPixelValue(x, y - 1) + GetPixelValue(x + 1, y - 1)) -
+			(GetPixelValue(x - 1, y + 1) + 2.0f * GetPixelValue(x, y + 1) + GetPixelValue(x + 1, y + 1));
+
+		EdgeSample& sample = this->edge_map(x, y);
+		sample.magnitude = (unsigned short)(sqrt(value_gx * value_gx + value_gy * value_gy) / 4.0);
+
+		// Maximum magnitude.
+		max = sample.magnitude > max ? sample.magnitude : max;
+
+		// Angle calculation.
+		float angle = 0.0;
+		if ((value_gx != 0.0) || (value_gy != 0.0)) {
+			angle = atan2(value_gy, value_gx) * 180.0 / PI;
 		}
-	}
-
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			this->edge_magnitude->operator()(y, x, 0, 0) = 255.0f * this->edge_magnitude->operator()(y, x, 0, 0) / max;
-			SetPixelValue(x, y, this->edge_magnitude->operator()(y, x, 0, 0));
+		if (((angle > -22.5) && (angle <= 22.5)) ||
+			(angle > 157.5) || (angle <= -157.5)) {
+			sample.direction = 0;
+		}
+		else if (((angle > 22.5) && (angle <= 67.5)) ||
+			((angle > -157.5) && (angle <= -112.5))) {
+			sample.direction = 45;
 		}
+		else if (((angle > 67.5) && (angle <= 112.5)) ||
+			((angle > -112.5) && (angle <= -67.5))) {
+			sample.direction = 90;
+		}
+		else {
+			sample.direction = 135;
+		}
+	});
+
+	// Normalization to 0-255.
+	if (max == 0.0) {
+		max = 1.0;
 	}
+	edge_map.ForEach(0, height, 0, width, [&](unsigned int x, unsigned int y) {
+		EdgeSample& sample = this->edge_map(x, y);
+		sample.magnitude = (unsigned short)(255.0f * sample.magnitude / max);
+		SetPixelValue(x, y, (uint8_t)sample.magnitude);
+	});
+
+	size_t pixels = (size_t)width * height;
+	bytes_read += pixels + pixels * sizeof(EdgeSample);
+	bytes_written += (size_t)(height - 2) * (width - 2) * sizeof(EdgeSample) +
+		pixels * sizeof(EdgeSample) + pixels;
 }
 
 void CannyEdgeDetector::NonMaxSuppression() {
@@ -324,144 +390,94 @@ void CannyEdgeDetector::NonMaxSuppression() {
 	float pixel_2 = 0;
 	float pixel;
 
-	for (x = 1; x < height - 1; x++) {
-		for (y = 1; y < width - 1; y++) {
-			if (this->edge_direction->operator()(y, x, 0, 0) == 0) {
-				pixel_1 = this->edge_magnitude->operator()(y, x + 1, 0, 0);
-				pixel_2 = this->edge_magnitude->operator()(y, x - 1, 0, 0);
-			}
-			else if (this->edge_direction->operator()(y, x, 0, 0) == 45) {
-				pixel_1 = this->edge_magnitude->operator()(y - 1, x + 1, 0, 0);
-				pixel_2 = this->edge_magnitude->operator()(y + 1, x - 1, 0, 0);
-			}
-			else if (this->edge_direction->operator()(y, x, 0, 0) == 90) {
-				pixel_1 = this->edge_magnitude->operator()(y - 1, x, 0, 0);
-				pixel_2 = this->edge_magnitude->operator()(y + 1, x, 0, 0);
-			}
-			else if (this->edge_direction->operator()(y, x, 0, 0) == 135) {
-				pixel_1 = this->edge_magnitude->operator()(y + 1, x + 1, 0, 0);
-				pixel_2 = this->edge_magnitude->operator()(y - 1, x - 1, 0, 0);
-			}
-			pixel = this->edge_magnitude->operator()(y, x, 0, 0);
-			if ((pixel >= pixel_1) && (pixel >= pixel_2)) {
-				SetPixelValue(x, y, pixel);
-			}
-			else {
-				SetPixelValue(x, y, 0);
-			}
+	edge_map.ForEach(1, height - 1, 1, width - 1, [&](unsigned int x, unsigned int y) {
+		const EdgeSample& sample = this->edge_map(x, y);
+		if (sample.direction == 0) {
+			pixel_1 = this->edge_map(x + 1, y).magnitude;
+			pixel_2 = this->edge_map(x - 1, y).magnitude;
 		}
-	}
-
-	bool change = true;
-	while (change) {
-		change = false;
-		for (x = 1; x < height - 1; x++) {
-			for (y = 1; y < width - 1; y++) {
-				if (GetPixelValue(x, y) == 255) {
-					if (GetPixelValue(x + 1, y) == 128) {
-						change = true;
-						SetPixelValue(x + 1, y, 255);
-					}
-					if (GetPixelValue(x - 1, y) == 128) {
-						change = true;
-						SetPixelValue(x - 1, y, 255);
-					}
-					if (GetPixelValue(x, y + 1) == 128) {
-						change = true;
-						SetPixelValue(x, y + 1, 255);
-					}
-					if (GetPixelValue(x, y - 1) == 128) {
-						change = true;
-						SetPixelValue(x, y - 1, 255);
-					}
-					if (GetPixelValue(x + 1, y + 1) == 128) {
-						change = true;
-						SetPixelValue(x + 1, y + 1, 255);
-					}
-					if (GetPixelValue(x - 1, y - 1) == 128) {
-						change = true;
-						SetPixelValue(x - 1, y - 1, 255);
-					}
-					if (GetPixelValue(x - 1, y + 1) == 128) {
-						change = true;
-						SetPixelValue(x - 1, y + 1, 255);
-					}
-					if (GetPixelValue(x + 1, y - 1) == 128) {
-						change = true;
-						SetPixelValue(x + 1, y - 1, 255);
-					}
-				}
+		else if (sample.direction == 45) {
+			pixel_1 = this->edge_map(x + 1, y - 1).magnitude;
+			pixel_2 = this->edge_map(x - 1, y + 1).magnitude;
+		}
+		else if (sample.direction == 90) {
+			pixel_1 = this->edge_map(x, y - 1).magnitude;
+			pixel_2 = this->edge_map(x, y + 1).magnitude;
+		}
+		else if (sample.direction == 135) {
+			pixel_1 = this->edge_map(x + 1, y + 1).magnitude;
+			pixel_2 = this->edge_map(x - 1, y - 1).magnitude;
+		}
+		pixel = sample.magnitude;
+		if ((pixel >= pixel_1) && (pixel >= pixel_2)) {
+			SetPixelValue(x, y, pixel);
+		}
+		else {
+			SetPixelValue(x, y, 0);
+		}
+	});
+
+	// Pixels of value 128 touching 255 become 255, until nothing changes.
+	// The result does not depend on the order of visiting pixels, so the
+	// sweeps walk memory order (forward, then backward) in both layouts.
+	bool change = false;
+	auto propagate = [&](unsigned int x, unsigned int y) {
+		if (GetPixelValue(x, y) != 255) {
+			return;
+		}
+		static const int offsets[8][2] = {
+			{ 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, -1 }, { -1, 1 }, { 1, -1 }
+		};
+		for (int i = 0; i < 8; i++) {
+			unsigned int x1 = x + offsets[i][0];
+			unsigned int y1 = y + offsets[i][1];
+			if (GetPixelValue(x1, y1) == 128) {
+				change = true;
+				SetPixelValue(x1, y1, 255);
 			}
 		}
+	};
+	unsigned int sweeps = 0;
+	do {
+		change = false;
+		sweeps++;
+		workspace_bitmap.ForEach(1, height - 1, 1, width - 1, propagate);
 		if (change) {
-			for (x = height - 2; x > 0; x--) {
-				for (y = width - 2; y > 0; y--) {
-					if (GetPixelValue(x, y) == 255) {
-						if (GetPixelValue(x + 1, y) == 128) {
-							change = true;
-							SetPixelValue(x + 1, y, 255);
-						}
-						if (GetPixelValue(x - 1, y) == 128) {
-							change = true;
-							SetPixelValue(x - 1, y, 255);
-						}
-						if (GetPixelValue(x, y + 1) == 128) {
-							change = true;
-							SetPixelValue(x, y + 1, 255);
-						}
-						if (GetPixelValue(x, y - 1) == 128) {
-							change = true;
-							SetPixelValue(x, y - 1, 255);
-						}
-						if (GetPixelValue(x + 1, y + 1) == 128) {
-							change = true;
-							SetPixelValue(x + 1, y + 1, 255);
-						}
-						if (GetPixelValue(x - 1, y - 1) == 128) {
-							change = true;
-							SetPixelValue(x - 1, y - 1, 255);
-						}
-						if (GetPixelValue(x - 1, y + 1) == 128) {
-							change = true;
-							SetPixelValue(x - 1, y + 1, 255);
-						}
-						if (GetPixelValue(x + 1, y - 1) == 128) {
-							change = true;
-							SetPixelValue(x + 1, y - 1, 255);
-						}
-					}
-				}
-			}
+			sweeps++;
+			workspace_bitmap.ForEachReverse(1, height - 1, 1, width - 1, propagate);
 		}
-	}
+	} while (change);
 
 	// Suppression
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			if (GetPixelValue(x, y) == 128) {
-				SetPixelValue(x, y, 0);
-			}
+	workspace_bitmap.ForEach(0, height, 0, width, [&](unsigned int x, unsigned int y) {
+		if (GetPixelValue(x, y) == 128) {
+			SetPixelValue(x, y, 0);
 		}
-	}
+	});
+
+	size_t inner = (size_t)(height - 2) * (width - 2);
+	size_t pixels = (size_t)width * height;
+	bytes_read += pixels * sizeof(EdgeSample) + sweeps * inner + pixels;
+	bytes_written += inner + sweeps * inner + pixels;
 }
 
 void CannyEdgeDetector::Hysteresis(uint8_t lowThreshold, uint8_t highThreshold) {
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			if (GetPixelValue(x, y) >= highThreshold) {
-				SetPixelValue(x, y, 255);
-				this->HysteresisRecursion(x, y, lowThreshold);
-			}
+	workspace_bitmap.ForEach(0, height, 0, width, [&](unsigned int x, unsigned int y) {
+		if (GetPixelValue(x, y) >= highThreshold) {
+			SetPixelValue(x, y, 255);
+			this->HysteresisRecursion(x, y, lowThreshold);
 		}
-	}
+	});
 
-	for (x = 0; x < height; x++) {
-		for (y = 0; y < width; y++) {
-			if (GetPixelValue(x, y) != 255) {
-				SetPixelValue(x, y, 0);
-			}
+	workspace_bitmap.ForEach(0, height, 0, width, [&](unsigned int x, unsigned int y) {
+		if (GetPixelValue(x, y) != 255) {
+			SetPixelValue(x, y, 0);
 		}
-	}
+	});
+
+	// Recursion only touches neighbourhoods of edges, it is not counted.
+	bytes_read += 2 * (size_t)width * height;
+	bytes_written += 2 * (size_t)width * height;
 }
 
 void CannyEdgeDetector::HysteresisRecursion(long x, long y, uint8_t lowThreshold) {
@@ -486,3 +502,258 @@ void CannyEdgeDetector::HysteresisRecursion(long x, long y, uint8_t lowThreshold
 		}
 	}
 }
+
+/*
+ * Word of row `row` (of `words` words) with all its neighbours along the
+ * row ORed in, including bits carried over from neighbouring words.
+ */
+static inline uint64_t SpreadWord(const uint64_t* row, unsigned int word, unsigned int words) {
+	uint64_t bits = row[word];
+	uint64_t spread = bits | (bits << 1) | (bits >> 1);
+	if (word > 0) {
+		spread |= row[word - 1] >> 63;
+	}
+	if (word + 1 < words) {
+		spread |= row[word + 1] << 63;
+	}
+	return spread;
+}
+
+/*
+ * Bits of runs of `mask` that contain a bit of `seed` (seed must be a
+ * subset of mask). Runs are filled in both directions with six doubling
+ * steps each (Kogge-Stone fill).
+ */
+static inline uint64_t FillRuns(uint64_t seed, uint64_t mask) {
+	uint64_t up = seed, down = seed;
+	uint64_t up_mask = mask, down_mask = mask;
+	for (unsigned int shift = 1; shift < 64; shift *= 2) {
+		up |= up_mask & (up << shift);
+		up_mask &= up_mask << shift;
+		down |= down_mask & (down >> shift);
+		down_mask &= down_mask >> shift;
+	}
+	return up | down;
+}
+
+void CannyEdgeDetector::HysteresisBitParallel(uint8_t lowThreshold, uint8_t highThreshold) {
+	row_words = (width + 63) / 64;
+	unsigned int tile_rows = (height + BIT_TILE_SIZE - 1) / BIT_TILE_SIZE;
+	size_t words = (size_t)row_words * height;
+	if (AssignVector(strong_bits, words, (uint64_t)0)) {
+		this->CountAllocation(BUFFER_STRONG_BITS, strong_bits.capacity() * sizeof(uint64_t));
+	}
+	if (AssignVector(weak_bits, words, (uint64_t)0)) {
+		this->CountAllocation(BUFFER_WEAK_BITS, weak_bits.capacity() * sizeof(uint64_t));
+	}
+	if (AssignVector(dirty_tiles, (size_t)row_words * tile_rows, (uint8_t)0)) {
+		this->CountAllocation(BUFFER_DIRTY_TILES, dirty_tiles.capacity());
+	}
+	bytes_written += 2 * words * sizeof(uint64_t);
+
+	// Classification, strong pixels are also weak.
+	workspace_bitmap.ForEach(0, height, 0, width, [&](unsigned int x, unsigned int y) {
+		uint8_t value = GetPixelValue(x, y);
+		uint64_t bit = (uint64_t)1 << (y % 64);
+		size_t index = (size_t)x * row_words + y / 64;
+		if (value >= lowThreshold || value >= highThreshold) {
+			weak_bits[index] |= bit;
+		}
+		if (value >= highThreshold) {
+			strong_bits[index] |= bit;
+		}
+	});
+
+	// Tiles with strong pixels may grow into themselves and into all
+	// their neighbours.
+	for (unsigned int tile_x = 0; tile_x < tile_rows; tile_x++) {
+		for (unsigned int word = 0; word < row_words; word++) {
+			uint64_t any = 0;
+			unsigned int last = std::min((tile_x + 1) * BIT_TILE_SIZE, height);
+			for (unsigned int x = tile_x * BIT_TILE_SIZE; x < last; x++) {
+				any |= strong_bits[(size_t)x * row_words + word];
+			}
+			if (any != 0) {
+				for (long i = -1; i <= 1; i++) {
+					for (long j = -1; j <= 1; j++) {
+						this->MarkTile((long)tile_x + i, (long)word + j);
+					}
+				}
+			}
+		}
+	}
+
+	// Sweeps over dirty tiles until all of them converge. Traffic of the
+	// word updates is summed here and added to the step once.
+	size_t words_read = 0, words_written = 0;
+	bool pending = true;
+	while (pending) {
+		pending = false;
+		for (unsigned int tile_x = 0; tile_x < tile_rows; tile_x++) {
+			for (unsigned int word = 0; word < row_words; word++) {
+				if (dirty_tiles[(size_t)tile_x * row_words + word]) {
+					dirty_tiles[(size_t)tile_x * row_words + word] = 0;
+					this->HysteresisTile(tile_x, word, words_read, words_written);
+					pending = true;
+				}
+			}
+		}
+	}
+
+	workspace_bitmap.ForEach(0, height, 0, width, [&](unsigned int x, unsigned int y) {
+		uint64_t bits = strong_bits[(size_t)x * row_words + y / 64];
+		SetPixelValue(x, y, ((bits >> (y % 64)) & 1) ? 255 : 0);
+	});
+
+	// Classification, growing and writing back the result.
+	bytes_read += (size_t)width * height + words * sizeof(uint64_t) + words_read * sizeof(uint64_t);
+	bytes_written += (size_t)width * height + words_written * sizeof(uint64_t);
+}
+
+void CannyEdgeDetector::HysteresisTile(unsigned int tile_x, unsigned int word, size_t& words_read,
+	size_t& words_written) {
+	unsigned int first = tile_x * BIT_TILE_SIZE;
+	unsigned int last = std::min(first + BIT_TILE_SIZE, height);
+	uint64_t before[BIT_TILE_SIZE];
+	for (unsigned int x = first; x < last; x++) {
+		before[x - first] = strong_bits[(size_t)x * row_words + word];
+	}
+
+	// Downward and upward sweeps, so that vertical chains converge in few
+	// iterations.
+	unsigned int passes = 0, changes = 0;
+	bool change = true;
+	while (change) {
+		change = false;
+		passes++;
+		for (unsigned int x = first; x < last; x++) {
+			if (this->HysteresisWord(x, word)) {
+				change = true;
+				changes++;
+			}
+		}
+		for (unsigned int x = last; x-- > first;) {
+			if (this->HysteresisWord(x, word)) {
+				change = true;
+				changes++;
+			}
+		}
+	}
+	// Every word update reads its weak and strong word, neighbouring words
+	// are counted by their own updates.
+	words_read += (size_t)passes * 2 * (last - first) * 2;
+	words_written += changes;
+
+	// Neighbours reading changed border bits have to be processed again.
+	uint64_t top = 0, bottom = 0, sides = 0;
+	for (unsigned int x = first; x < last; x++) {
+		uint64_t changed = strong_bits[(size_t)x * row_words + word] ^ before[x - first];
+		sides |= changed;
+		if (x == first) {
+			top = changed;
+		}
+		if (x == last - 1) {
+			bottom = changed;
+		}
+	}
+	long tile_row = (long)tile_x, tile_column = (long)word;
+	if (top != 0) {
+		this->MarkTile(tile_row - 1, tile_column);
+		if (top & 1) {
+			this->MarkTile(tile_row - 1, tile_column - 1);
+		}
+		if (top >> 63) {
+			this->MarkTile(tile_row - 1, tile_column + 1);
+		}
+	}
+	if (bottom != 0) {
+		this->MarkTile(tile_row + 1, tile_column);
+		if (bottom & 1) {
+			this->MarkTile(tile_row + 1, tile_column - 1);
+		}
+		if (bottom >> 63) {
+			this->MarkTile(tile_row + 1, tile_column + 1);
+		}
+	}
+	if (sides & 1) {
+		this->MarkTile(tile_row, tile_column - 1);
+	}
+	if (sides >> 63) {
+		this->MarkTile(tile_row, tile_column + 1);
+	}
+}
+
+bool CannyEdgeDetector::HysteresisWord(unsigned int x, unsigned int word) {
+	uint64_t* row = &strong_bits[(size_t)x * row_words];
+	uint64_t weak = weak_bits[(size_t)x * row_words + word];
+	uint64_t current = row[word];
+
+	// 8-neighbourhood of strong pixels in rows x - 1, x and x + 1.
+	uint64_t neighbours = SpreadWord(row, word, row_words);
+	if (x > 0) {
+		neighbours |= SpreadWord(row - row_words, word, row_words);
+	}
+	if (x + 1 < height) {
+		neighbours |= SpreadWord(row + row_words, word, row_words);
+	}
+
+	uint64_t grown = current | FillRuns(neighbours & weak, weak);
+	if (grown == current) {
+		return false;
+	}
+	row[word] = grown;
+	return true;
+}
+
+void CannyEdgeDetector::MarkTile(long tile_x, long word) {
+	long tile_rows = (long)((height + BIT_TILE_SIZE - 1) / BIT_TILE_SIZE);
+	if (tile_x < 0 || word < 0 || tile_x >= tile_rows || word >= (long)row_words) {
+		return;
+	}
+	dirty_tiles[(size_t)tile_x * row_words + word] = 1;
+}
+
+void CannyEdgeDetector::BeginMetrics() {
+	metrics.allocations = 0;
+	metrics.allocated_bytes = 0;
+	metrics.stages.clear();
+	for (unsigned int i = 0; i < BUFFER_COUNT; i++) {
+		metrics.buffers[i].allocations = 0;
+	}
+	bytes_read = 0;
+	bytes_written = 0;
+}
+
+void CannyEdgeDetector::CountAllocation(Buffer buffer, size_t bytes) {
+	metrics.allocations++;
+	metrics.allocated_bytes += bytes;
+	metrics.buffers[buffer].allocations++;
+}
+
+void CannyEdgeDetector::FinishStage(const char* name) {
+	StageMetrics stage = { name, bytes_read, bytes_written };
+	metrics.stages.push_back(stage);
+	bytes_read = 0;
+	bytes_written = 0;
+	this->UpdateBufferMetrics();
+}
+
+void CannyEdgeDetector::UpdateBufferMetrics() {
+	size_t bytes[BUFFER_COUNT];
+	bytes[BUFFER_WORKSPACE] = workspace_bitmap.Bytes();
+	bytes[BUFFER_BLUR] = blur_bitmap.Bytes();
+	bytes[BUFFER_EDGE_MAP] = edge_map.Bytes();
+	bytes[BUFFER_GAUSSIAN_MASK] = gaussian_mask.capacity() * sizeof(float);
+	bytes[BUFFER_STRONG_BITS] = strong_bits.capacity() * sizeof(uint64_t);
+	bytes[BUFFER_WEAK_BITS] = weak_bits.capacity() * sizeof(uint64_t);
+	bytes[BUFFER_DIRTY_TILES] = dirty_tiles.capacity();
+
+	metrics.current_bytes = 0;
+	for (unsigned int i = 0; i < BUFFER_COUNT; i++) {
+		BufferMetrics& buffer = metrics.buffers[i];
+		buffer.current_bytes = bytes[i];
+		buffer.peak_bytes = std::max(buffer.peak_bytes, bytes[i]);
+		metrics.current_bytes += bytes[i];
+	}
+	metrics.peak_bytes = std::max(metrics.peak_bytes, metrics.current_bytes);
+}
@@ -10,16 +10,83 @@
 
 #ifndef _CANNYEDGEDETECTOR_H_
 #define _CANNYEDGEDETECTOR_H_
+#include <vector>
 #include "CImg.h"
+#include "DetectorMetrics.h"
+#include "ImageIO.h"
+#include "PixelBuffer.h"
 using namespace cimg_library;
 
 typedef unsigned char uint8_t;
 
+/**
+ * \brief Edge pixel found by Canny algorithm.
+ *
+ * Coordinates follow the convention of `CannyEdgeDetector`: x is the row
+ * counter and y is the column counter of the original (not enlarged) image.
+ */
+struct EdgePoint {
+	/**
+	 * \var Pixel x coordinate (row).
+	 */
+	unsigned int x;
+
+	/**
+	 * \var Pixel y coordinate (column).
+	 */
+	unsigned int y;
+
+	/**
+	 * \var Quantized gradient direction (0, 45, 90 or 135 degrees).
+	 */
+	uint8_t direction;
+};
+
+/**
+ * \brief Gradient information of one pixel.
+ *
+ * Magnitude and direction are used together, so they are packed into one
+ * 32-bit word.
+ */
+struct EdgeSample {
+	/**
+	 * \var Gradient magnitude (normalized to 0-255 after edge detection).
+	 */
+	unsigned short magnitude;
+
+	/**
+	 * \var Quantized gradient direction (0, 45, 90 or 135 degrees).
+	 */
+	uint8_t direction;
+
+	/**
+	 * \var Padding.
+	 */
+	uint8_t reserved;
+};
+
+/**
+ * \brief Implementation of hysteresis thresholding.
+ */
+enum class HysteresisMode {
+	/**
+	 * \var Recursive tracing from every strong pixel, one byte per pixel.
+	 */
+	Recursive,
+
+	/**
+	 * \var Strong and weak pixels packed into 64-bit words, 64 pixels of a
+	 * row are grown at once.
+	 */
+	BitParallel
+};
+
 /**
  * \brief Canny algorithm class.
  *
  * Algorithm executes each step of Canny algorithm in one method,
- * ProcessImage. It operates on 24-bit RGB (BGR) bitmap.
+ * ProcessImage. It operates on 24-bit RGB (BGR) bitmap or 8-bit gray bitmap
+ * accessed through `ImageView`.
  */
 class CannyEdgeDetector {
 public:
@@ -56,7 +123,7 @@ public:
 	 * Above steps are performed on image data organised in two-dimensional
 	 * array of bytes which size is calculated as `width` * `height` * 3.
 	 * Almost all of them are performed on `workspace_bitmap` which is
-	 * higher and wider by few pixels than `source_bitmap`. This is because
+	 * higher and wider by few pixels than source image. This is because
 	 * we need to have additional margins in order to make the steps that
 	 * use masks work on every pixel of original image. For instance, Sobel
 	 * mask is 3x3 so we need at least 1 pixel margin on every side. But the
@@ -85,26 +152,180 @@ public:
 		unsigned int height, float sigma = 1.0f,
 		uint8_t lowThreshold = 30, uint8_t highThreshold = 80);
 
+	/**
+	 * \brief Main method processing image, working on image views.
+	 *
+	 * Same as above, but source is read and result is written in place
+	 * through views, e.g. of memory-mapped files (see `MappedImage`).
+	 * Source is only read, destination gets the same value in every
+	 * channel. Both views must have the same width and height and may
+	 * describe the same memory.
+	 *
+	 * \param source Source image (1 or 3 channels).
+	 * \param destination Destination image (any number of channels).
+	 * \param sigma Gaussian function standard deviation.
+	 * \param lowThreshold Lower threshold of hysteresis (from range of 0-255).
+	 * \param highThreshold Upper threshold of hysteresis (from range of 0-255).
+	 */
+	void ProcessImage(const ImageView& source, const ImageView& destination,
+		float sigma = 1.0f, uint8_t lowThreshold = 30, uint8_t highThreshold = 80);
+
+	/**
+	 * \brief Collects edge pixels found by the last `ProcessImage()` call.
+	 *
+	 * Every pixel marked as edge is returned together with its value from
+	 * `edge_map`, so that later stages (e.g. Hough transform) do not
+	 * have to rescan the result bitmap nor recompute the gradient.
+	 *
+	 * \param points Vector the edge pixels are appended to.
+	 */
+	void GetEdgePoints(std::vector<EdgePoint>& points);
+
+	/**
+	 * \brief Selects memory layout of internal arrays.
+	 *
+	 * By default arrays are stored row by row. With tiles, every
+	 * `tileSize` x `tileSize` square is stored contiguously, which keeps
+	 * neighbouring rows used by masks in cache on very wide images.
+	 *
+	 * \param tileSize Size of tile side, power of two (e.g. 64); 0 selects
+	 * row by row layout.
+	 */
+	void SetTileSize(unsigned int tileSize);
+
+	/**
+	 * \brief Selects implementation of hysteresis thresholding.
+	 *
+	 * `HysteresisMode::BitParallel` keeps every pixel at least
+	 * `lowThreshold` which is 8-connected through such pixels to a pixel at
+	 * least `highThreshold`. It grows the strong set by word-wide
+	 * dilations in tiles of 64 rows x 64 columns, until nothing changes;
+	 * tiles are revisited only when bits on the border of a neighbour
+	 * change.
+	 *
+	 * \param mode Hysteresis implementation, `HysteresisMode::Recursive` by
+	 * default.
+	 */
+	void SetHysteresisMode(HysteresisMode mode);
+
+	/**
+	 * \brief Sets receiver of metrics of every processed image.
+	 *
+	 * Sink is not owned by the detector and must outlive it (or be
+	 * replaced before it is destroyed).
+	 *
+	 * \param sink Metrics sink, NULL restores the default sink which
+	 * ignores metrics.
+	 */
+	void SetMetricsSink(MetricsSink* sink);
+
+	/**
+	 * \brief Gets memory and traffic accounting of the last processed image.
+	 *
+	 * \return Metrics of the last `ProcessImage()` call.
+	 */
+	const DetectorMetrics& GetMetrics() const;
+
 private:
 	/**
-	 * \var Bitmap with source image.
+	 * \brief Indices of internal buffers in `DetectorMetrics::buffers`.
 	 */
-	CImg<unsigned char>* source_bitmap;
+	enum Buffer {
+		BUFFER_WORKSPACE,
+		BUFFER_BLUR,
+		BUFFER_EDGE_MAP,
+		BUFFER_GAUSSIAN_MASK,
+		BUFFER_STRONG_BITS,
+		BUFFER_WEAK_BITS,
+		BUFFER_DIRTY_TILES,
+		BUFFER_COUNT
+	};
+
+	/**
+	 * \var Rows (and columns) of one tile of bit-parallel hysteresis.
+	 */
+	static const unsigned int BIT_TILE_SIZE = 64;
+
+	/**
+	 * \var View of source image.
+	 */
+	ImageView source_view;
+
+	/**
+	 * \var View of destination image.
+	 */
+	ImageView destination_view;
 
 	/**
 	 * \var Bitmap with image that algorithm is working on.
 	 */
-	CImg<unsigned char>* workspace_bitmap;
+	PixelBuffer<uint8_t> workspace_bitmap;
+
+	/**
+	 * \var Bitmap with image blurred along rows only.
+	 */
+	PixelBuffer<uint8_t> blur_bitmap;
+
+	/**
+	 * \var Array storing gradient magnitude and edge direction.
+	 */
+	PixelBuffer<EdgeSample> edge_map;
+
+	/**
+	 * \var Size of tile side of internal arrays, 0 for row by row layout.
+	 */
+	unsigned int tile_size;
+
+	/**
+	 * \var Coefficients of 1D Gauss mask, kept between calls.
+	 */
+	std::vector<float> gaussian_mask;
+
+	/**
+	 * \var Accounting of the current (or last) processed image.
+	 */
+	DetectorMetrics metrics;
+
+	/**
+	 * \var Receiver of metrics, never NULL.
+	 */
+	MetricsSink* metrics_sink;
+
+	/**
+	 * \var Bytes read by the current step so far.
+	 */
+	size_t bytes_read;
+
+	/**
+	 * \var Bytes written by the current step so far.
+	 */
+	size_t bytes_written;
+
+	/**
+	 * \var Implementation of hysteresis thresholding.
+	 */
+	HysteresisMode hysteresis_mode;
+
+	/**
+	 * \var Bit-parallel hysteresis: pixels accepted as edges so far, one
+	 * bit per pixel, `row_words` words per row.
+	 */
+	std::vector<uint64_t> strong_bits;
+
+	/**
+	 * \var Bit-parallel hysteresis: pixels at least the lower threshold.
+	 */
+	std::vector<uint64_t> weak_bits;
 
 	/**
-	 * \var Array storing gradient magnitude.
+	 * \var Bit-parallel hysteresis: tiles that have to be (re)processed.
 	 */
-	CImg<unsigned char>* edge_magnitude;
+	std::vector<uint8_t> dirty_tiles;
 
 	/**
-	 * \var Array storing edge direction (0, 45, 90 and 135 degrees).
+	 * \var Number of 64-bit words of one row of bit maps.
 	 */
-	CImg<unsigned char>* edge_direction;
+	unsigned int row_words;
 
 	/**
 	 * \var Width of currently processed image, in pixels.
@@ -159,7 +380,7 @@ private:
 	inline void SetPixelValue(unsigned int x, unsigned int y, uint8_t value);
 
 	/**
-	 * \brief Initializes arrays for use by the algorithm.
+	 * \brief Allocates arrays for use by the algorithm.
 	 *
 	 * \param sigma Parameter used for calculation of margin that the image
 	 * must be enlarged with.
@@ -167,14 +388,16 @@ private:
 	void PreProcessImage(float sigma);
 
 	/**
-	 * \brief Cuts margins and returns image of original size.
+	 * \brief Cuts margins and writes result into destination image.
 	 */
 	void PostProcessImage();
 
 	/**
-	 * \brief Converts image to grayscale.
+	 * \brief Converts source image to grayscale.
 	 *
 	 * Information of chrominance are useless, we only need grayscale image.
+	 * Result is stored in the middle of `workspace_bitmap`, margins are
+	 * filled with copies of the outermost pixels.
 	 */
 	void Luminance();
 
@@ -191,8 +414,8 @@ private:
 	/**
 	 * \brief Calculates magnitude and direction of image gradient.
 	 *
-	 * Method saves results in two arrays, edge_magnitude and
-	 * edge_direction.
+	 * Method saves results in `edge_map` and copies normalized magnitude
+	 * into `workspace_bitmap`.
 	 */
 	void EdgeDetection();
 
@@ -221,6 +444,70 @@ private:
 	 * \param lowThreshold Lower threshold of hysteresis (from range of 0-255).
 	 */
 	void HysteresisRecursion(long x, long y, uint8_t lowThreshold);
+
+	/**
+	 * \brief Performs hysteresis thresholding on packed bit maps.
+	 *
+	 * \param lowThreshold Lower threshold of hysteresis (from range of 0-255).
+	 * \param highThreshold Upper threshold of hysteresis (from range of 0-255).
+	 */
+	void HysteresisBitParallel(uint8_t lowThreshold, uint8_t highThreshold);
+
+	/**
+	 * \brief Grows strong pixels of one tile until nothing changes.
+	 *
+	 * Tiles next to changed border bits are marked dirty.
+	 *
+	 * \param tile_x Tile row.
+	 * \param word Tile column, index of word in a row.
+	 * \param words_read Increased by number of words read.
+	 * \param words_written Increased by number of words written.
+	 */
+	void HysteresisTile(unsigned int tile_x, unsigned int word, size_t& words_read, size_t& words_written);
+
+	/**
+	 * \brief Adds weak pixels of one word touching strong pixels.
+	 *
+	 * \param x Row of the word.
+	 * \param word Index of the word in the row.
+	 * \return True if any pixel was added.
+	 */
+	bool HysteresisWord(unsigned int x, unsigned int word);
+
+	/**
+	 * \brief Marks tile dirty, tiles outside the image are ignored.
+	 *
+	 * \param tile_x Tile row.
+	 * \param word Tile column.
+	 */
+	void MarkTile(long tile_x, long word);
+
+	/**
+	 * \brief Resets per-call accounting before processing an image.
+	 */
+	void BeginMetrics();
+
+	/**
+	 * \brief Records an allocation of internal buffer.
+	 *
+	 * \param buffer Index of the buffer.
+	 * \param bytes Size of the allocation.
+	 */
+	void CountAllocation(Buffer buffer, size_t bytes);
+
+	/**
+	 * \brief Records traffic of finished step and current buffer sizes.
+	 *
+	 * `bytes_read` and `bytes_written` are reset for the next step.
+	 *
+	 * \param name Name of the step.
+	 */
+	void FinishStage(const char* name);
+
+	/**
+	 * \brief Updates current and peak bytes of every buffer.
+	 */
+	void UpdateBufferMetrics();
 };
 
 #endif // #ifndef _CANNYEDGEDETECTOR_H_
@@ -0,0 +1,124 @@
+/**
+ * \file      DetectorMetrics.h
+ * \brief     Memory and traffic accounting of Canny algorithm.
+ * \details   `CannyEdgeDetector` fills `DetectorMetrics` during every
+ *            `ProcessImage()` call and passes it to a `MetricsSink`, which
+ *            may export it anywhere.
+ */
+
+#ifndef _DETECTORMETRICS_H_
+#define _DETECTORMETRICS_H_
+#include <stddef.h>
+#include <vector>
+
+/**
+ * \brief Memory held by one internal buffer.
+ */
+struct BufferMetrics {
+	/**
+	 * \var Name of the buffer.
+	 */
+	const char* name;
+
+	/**
+	 * \var Bytes held at the end of the last call.
+	 */
+	size_t current_bytes;
+
+	/**
+	 * \var Most bytes held at once since the detector was created. Sampled
+	 * only at the end of every step, so it is a lower bound.
+	 */
+	size_t peak_bytes;
+
+	/**
+	 * \var Number of allocations during the last call.
+	 */
+	unsigned int allocations;
+};
+
+/**
+ * \brief Memory traffic of one step of the algorithm.
+ *
+ * Every element of a buffer is counted once per pass over it, even if a
+ * mask reads it several times; neighbours are expected to stay in cache.
+ */
+struct StageMetrics {
+	/**
+	 * \var Name of the step.
+	 */
+	const char* name;
+
+	/**
+	 * \var Bytes read.
+	 */
+	size_t bytes_read;
+
+	/**
+	 * \var Bytes written.
+	 */
+	size_t bytes_written;
+};
+
+/**
+ * \brief Accounting of one `CannyEdgeDetector::ProcessImage()` call.
+ */
+struct DetectorMetrics {
+	/**
+	 * \var Number of allocations during the call.
+	 */
+	unsigned int allocations;
+
+	/**
+	 * \var Bytes allocated during the call.
+	 */
+	size_t allocated_bytes;
+
+	/**
+	 * \var Bytes held by all buffers at the end of the call.
+	 */
+	size_t current_bytes;
+
+	/**
+	 * \var Most bytes held by all buffers at once since the detector was
+	 * created. Sampled only at the end of every step, so it is a lower
+	 * bound.
+	 */
+	size_t peak_bytes;
+
+	/**
+	 * \var Every internal buffer.
+	 */
+	std::vector<BufferMetrics> buffers;
+
+	/**
+	 * \var Steps in order of execution.
+	 */
+	std::vector<StageMetrics> stages;
+};
+
+/**
+ * \brief Receiver of detector metrics.
+ *
+ * Default implementation ignores them; derived classes override
+ * `Report()` to print, aggregate or export them.
+ */
+class MetricsSink {
+public:
+	/**
+	 * \brief Destructor.
+	 */
+	virtual ~MetricsSink() {
+	}
+
+	/**
+	 * \brief Called at the end of every processed image.
+	 *
+	 * \param metrics Accounting of the call, also available later from
+	 * `CannyEdgeDetector::GetMetrics()`.
+	 */
+	virtual void Report(const DetectorMetrics& /*metrics*/) {
+	}
+};
+
+#endif // #ifndef _DETECTORMETRICS_H_
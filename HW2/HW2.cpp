@@ -1,15 +1,49 @@
 ﻿#include <iostream>
 #include "CImg.h"
 #include "CannyEdgeDetector.h"
+#include "HoughTransform.h"
+#include "ImageIO.h"
 using namespace std;
 using namespace cimg_library;
 
 int main() {
-	CImg<unsigned char>* image = new CImg<unsigned char>();
 	string path = "C:/Users/User/OneDrive/资料/研二/计算机视觉助教/第二次作业/test_Data/lena.bmp";
-	image->load(path.c_str());
+	string answerPath = "C:/Users/User/Desktop/temp/answer.bmp";
 	CannyEdgeDetector cannyEdgeDetector;
-	CImg<unsigned char>* answer = cannyEdgeDetector.ProcessImage(image, image->width(), image->height());
-	path = "C:/Users/User/Desktop/temp/answer.bmp";
-	answer->save(path.c_str());
+	unsigned int width = 0;
+	unsigned int height = 0;
+
+	// Uncompressed files are processed in place, without decoding.
+	MappedImage source;
+	MappedImage answer;
+	if (source.Open(path.c_str()) &&
+		answer.Create(answerPath.c_str(), MappedImage::FormatFromPath(answerPath.c_str()),
+			source.View().width, source.View().height, source.View().channels)) {
+		width = source.View().width;
+		height = source.View().height;
+		cannyEdgeDetector.ProcessImage(source.View(), answer.View());
+		answer.Close();
+	}
+	else {
+		CImg<unsigned char>* image = new CImg<unsigned char>();
+		image->load(path.c_str());
+		width = image->width();
+		height = image->height();
+		CImg<unsigned char>* answer = cannyEdgeDetector.ProcessImage(image, width, height);
+		answer->save(answerPath.c_str());
+		delete image;
+	}
+
+	const DetectorMetrics& metrics = cannyEdgeDetector.GetMetrics();
+	cout << "memory: peak = " << metrics.peak_bytes << " bytes, allocations = "
+		<< metrics.allocations << endl;
+
+	vector<EdgePoint> points;
+	cannyEdgeDetector.GetEdgePoints(points);
+	HoughTransform houghTransform;
+	vector<HoughLine> lines = houghTransform.FindLines(points, width, height, 50, 20);
+	for (size_t i = 0; i < lines.size(); i++) {
+		cout << "rho = " << lines[i].rho << ", theta = " << lines[i].theta
+			<< ", votes = " << lines[i].votes << endl;
+	}
 }
@@ -0,0 +1,190 @@
+/**
+ * \file      HoughTransform.cpp
+ * \brief     Hough line transform class file.
+ * \details   Line search working directly on edge pixels produced by
+ *            `CannyEdgeDetector`.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include "HoughTransform.h"
+
+HoughTransform::HoughTransform() {
+	rho_count = (unsigned int)0;
+	rho_max = (unsigned int)0;
+
+	for (unsigned int i = 0; i < THETA_COUNT; i++) {
+		float theta = i * CannyEdgeDetector::PI / THETA_COUNT;
+		cos_table[i] = cos(theta);
+		sin_table[i] = sin(theta);
+	}
+}
+
+HoughTransform::~HoughTransform() {
+}
+
+static bool CompareVotes(const HoughLine& a, const HoughLine& b) {
+	return a.votes > b.votes;
+}
+
+std::vector<HoughLine> HoughTransform::FindLines(const std::vector<EdgePoint>& points, unsigned int width,
+	unsigned int height, unsigned int minVotes, unsigned int maxLines,
+	float angleWindow, unsigned int threadCount) {
+	/*
+	 * Rho ranges from minus to plus length of the diagonal.
+	 */
+	rho_max = (unsigned int)ceil(sqrt((float)width * width + (float)height * height));
+	rho_count = 2 * rho_max + 1;
+	size_t cell_count = (size_t)THETA_COUNT * rho_count;
+
+	/*
+	 * Every thread gets at least a few thousands of pixels, otherwise
+	 * clearing and summing accumulators costs more than voting.
+	 */
+	if (threadCount == 0) {
+		threadCount = std::thread::hardware_concurrency();
+	}
+	threadCount = std::min(threadCount, (unsigned int)(points.size() / 4096 + 1));
+	threadCount = std::max(threadCount, 1u);
+
+	int window = (int)ceil(angleWindow * THETA_COUNT / 180.0f);
+	window = std::min(window, (int)THETA_COUNT / 2);
+
+	/*
+	 * Voting, each thread into its own accumulator.
+	 */
+	thread_accumulators.resize(threadCount);
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < threadCount; i++) {
+		thread_accumulators[i].assign(cell_count, 0);
+		size_t begin = points.size() * i / threadCount;
+		size_t end = points.size() * (i + 1) / threadCount;
+		if (i == threadCount - 1) {
+			this->Vote(points, begin, end, window, thread_accumulators[i]);
+		}
+		else {
+			threads.push_back(std::thread(&HoughTransform::Vote, this, std::cref(points), begin, end,
+				window, std::ref(thread_accumulators[i])));
+		}
+	}
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+	threads.clear();
+
+	/*
+	 * Reduction, each thread sums its own range of cells.
+	 */
+	accumulator.resize(cell_count);
+	for (unsigned int i = 0; i < threadCount; i++) {
+		size_t begin = cell_count * i / threadCount;
+		size_t end = cell_count * (i + 1) / threadCount;
+		if (i == threadCount - 1) {
+			this->Reduce(begin, end);
+		}
+		else {
+			threads.push_back(std::thread(&HoughTransform::Reduce, this, begin, end));
+		}
+	}
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	/*
+	 * Peak extraction.
+	 */
+	std::vector<HoughLine> lines;
+	this->ExtractPeaks(std::max(minVotes, 1u), lines);
+	std::sort(lines.begin(), lines.end(), CompareVotes);
+	if (maxLines != 0 && lines.size() > maxLines) {
+		lines.resize(maxLines);
+	}
+	return lines;
+}
+
+void HoughTransform::Vote(const std::vector<EdgePoint>& points, size_t begin, size_t end,
+	int window, std::vector<unsigned int>& votes) {
+	for (size_t i = begin; i < end; i++) {
+		const EdgePoint& point = points[i];
+		float row = (float)point.x;
+		float column = (float)point.y;
+
+		// Line normal is parallel to gradient. Direction 0 means vertical
+		// gradient (see CannyEdgeDetector::EdgeDetection), so it is rotated
+		// by 90 degrees to get angle between the normal and the y axis.
+		int center = ((point.direction + 90) % 180) * THETA_COUNT / 180;
+
+		for (int t = center - window; t <= center + window; t++) {
+			unsigned int theta = (unsigned int)((t + THETA_COUNT) % THETA_COUNT);
+			float rho = column * cos_table[theta] + row * sin_table[theta];
+			int rho_index = (int)floor(rho + 0.5f) + (int)rho_max;
+			votes[(size_t)theta * rho_count + rho_index]++;
+		}
+	}
+}
+
+void HoughTransform::Reduce(size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		accumulator[i] = thread_accumulators[0][i];
+	}
+	for (size_t j = 1; j < thread_accumulators.size(); j++) {
+		const unsigned int* votes = thread_accumulators[j].data();
+		for (size_t i = begin; i < end; i++) {
+			accumulator[i] += votes[i];
+		}
+	}
+}
+
+unsigned int HoughTransform::GetVotes(int theta, int rho) {
+	if (theta < 0) {
+		theta += THETA_COUNT;
+		rho = (int)rho_count - 1 - rho;
+	}
+	else if (theta >= (int)THETA_COUNT) {
+		theta -= THETA_COUNT;
+		rho = (int)rho_count - 1 - rho;
+	}
+	if ((rho < 0) || (rho >= (int)rho_count)) {
+		return 0;
+	}
+	return accumulator[(size_t)theta * rho_count + rho];
+}
+
+void HoughTransform::ExtractPeaks(unsigned int minVotes, std::vector<HoughLine>& lines) {
+	for (int theta = 0; theta < (int)THETA_COUNT; theta++) {
+		const unsigned int* row = accumulator.data() + (size_t)theta * rho_count;
+		for (int rho = 0; rho < (int)rho_count; rho++) {
+			unsigned int value = row[rho];
+			if (value < minVotes) {
+				continue;
+			}
+
+			// Plateaus are resolved in favour of the first cell, so that
+			// one line is not reported twice.
+			bool peak = true;
+			for (int i = -PEAK_HALFSIZE; i <= PEAK_HALFSIZE && peak; i++) {
+				for (int j = -PEAK_HALFSIZE; j <= PEAK_HALFSIZE; j++) {
+					if (i == 0 && j == 0) {
+						continue;
+					}
+					unsigned int neighbour = GetVotes(theta + i, rho + j);
+					bool before = (i < 0) || (i == 0 && j < 0);
+					if ((neighbour > value) || (before && neighbour == value)) {
+						peak = false;
+						break;
+					}
+				}
+			}
+
+			if (peak) {
+				HoughLine line;
+				line.rho = (float)rho - (float)rho_max;
+				line.theta = theta * 180.0f / THETA_COUNT;
+				line.votes = value;
+				lines.push_back(line);
+			}
+		}
+	}
+}
@@ -0,0 +1,157 @@
+/**
+ * \file      HoughTransform.h
+ * \brief     Hough line transform header file.
+ * \details   Line search working directly on edge pixels produced by
+ *            `CannyEdgeDetector`.
+ */
+
+#ifndef _HOUGHTRANSFORM_H_
+#define _HOUGHTRANSFORM_H_
+#include <vector>
+#include "CannyEdgeDetector.h"
+
+/**
+ * \brief Line found by Hough transform.
+ *
+ * Line is stored in normal form: rho = y * cos(theta) + x * sin(theta),
+ * where x is the row and y is the column of a pixel (the same convention
+ * as in `CannyEdgeDetector`).
+ */
+struct HoughLine {
+	/**
+	 * \var Distance of the line from the upper left corner, in pixels.
+	 */
+	float rho;
+
+	/**
+	 * \var Angle of the line normal, in degrees (from range of 0-180).
+	 */
+	float theta;
+
+	/**
+	 * \var Number of edge pixels that voted for the line.
+	 */
+	unsigned int votes;
+};
+
+/**
+ * \brief Hough line transform class.
+ *
+ * Voting is restricted by gradient direction: an edge pixel votes only for
+ * lines whose normal lies within `angleWindow` degrees from its gradient.
+ * Edge pixels are split between threads, every thread votes into its own
+ * accumulator, accumulators are summed and local maxima are extracted.
+ */
+class HoughTransform {
+public:
+	/**
+	 * \brief Constructor, initializes some private variables.
+	 */
+	HoughTransform();
+
+	/**
+	 * \brief Destructor, unallocates memory.
+	 */
+	~HoughTransform();
+
+	/**
+	 * \brief Main method searching for lines.
+	 *
+	 * \param points Edge pixels, see `CannyEdgeDetector::GetEdgePoints()`.
+	 * \param width Width of image the points come from.
+	 * \param height Height of image the points come from.
+	 * \param minVotes Minimal number of votes of returned line.
+	 * \param maxLines Maximal number of returned lines (0 means no limit).
+	 * \param angleWindow Half width of voting window around gradient
+	 * direction, in degrees. Directions are quantized to 45 degrees, so
+	 * the window should not be narrower than 22.5 degrees.
+	 * \param threadCount Number of voting threads (0 means one per core).
+	 * \return Lines found, sorted by number of votes (descending).
+	 */
+	std::vector<HoughLine> FindLines(const std::vector<EdgePoint>& points, unsigned int width,
+		unsigned int height, unsigned int minVotes = 50, unsigned int maxLines = 0,
+		float angleWindow = 30.0f, unsigned int threadCount = 0);
+
+private:
+	/**
+	 * \var Size of the accumulator in theta dimension (1 degree steps).
+	 */
+	static const unsigned int THETA_COUNT = 180;
+
+	/**
+	 * \var Half size of the neighbourhood used in peak extraction.
+	 */
+	static const int PEAK_HALFSIZE = 2;
+
+	/**
+	 * \var Cosine of every accumulator angle.
+	 */
+	float cos_table[THETA_COUNT];
+
+	/**
+	 * \var Sine of every accumulator angle.
+	 */
+	float sin_table[THETA_COUNT];
+
+	/**
+	 * \var Size of the accumulator in rho dimension.
+	 */
+	unsigned int rho_count;
+
+	/**
+	 * \var Maximal absolute value of rho (image diagonal).
+	 */
+	unsigned int rho_max;
+
+	/**
+	 * \var Accumulator after reduction, `THETA_COUNT` * `rho_count` cells.
+	 */
+	std::vector<unsigned int> accumulator;
+
+	/**
+	 * \var Per-thread accumulators.
+	 */
+	std::vector<std::vector<unsigned int> > thread_accumulators;
+
+	/**
+	 * \brief Votes with a range of edge pixels into one accumulator.
+	 *
+	 * \param points Edge pixels.
+	 * \param begin Index of first pixel.
+	 * \param end Index after last pixel.
+	 * \param window Half width of voting window, in accumulator cells.
+	 * \param votes Accumulator to vote into.
+	 */
+	void Vote(const std::vector<EdgePoint>& points, size_t begin, size_t end,
+		int window, std::vector<unsigned int>& votes);
+
+	/**
+	 * \brief Sums part of per-thread accumulators into `accumulator`.
+	 *
+	 * \param begin Index of first cell.
+	 * \param end Index after last cell.
+	 */
+	void Reduce(size_t begin, size_t end);
+
+	/**
+	 * \brief Gets accumulator value, wrapping theta around 180 degrees.
+	 *
+	 * Line (rho, theta - 180) is the same as (-rho, theta), so cells left
+	 * of the first column are taken from the last column mirrored in rho.
+	 *
+	 * \param theta Theta index, may be out of range by less than 180.
+	 * \param rho Rho index, may be out of range.
+	 * \return Number of votes in the cell, 0 for cells outside.
+	 */
+	unsigned int GetVotes(int theta, int rho);
+
+	/**
+	 * \brief Non-maximum suppression of the accumulator.
+	 *
+	 * \param minVotes Minimal number of votes of returned line.
+	 * \param lines Vector the local maxima are appended to.
+	 */
+	void ExtractPeaks(unsigned int minVotes, std::vector<HoughLine>& lines);
+};
+
+#endif // #ifndef _HOUGHTRANSFORM_H_
@@ -0,0 +1,441 @@
+/**
+ * \file      ImageIO.cpp
+ * \brief     Memory-mapped image input/output class file.
+ * \details   Uncompressed PGM, PPM, BMP and raw files are mapped into memory
+ *            and exposed as strided views, so that pixels are read and
+ *            written in place, without decoding into intermediate buffers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "ImageIO.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+ImageView ImageView::FromCImg(CImg<unsigned char>* image) {
+	ImageView view;
+	view.data = image->data();
+	view.width = image->width();
+	view.height = image->height();
+	view.channels = image->spectrum();
+	view.pixel_stride = 1;
+	view.row_stride = image->width();
+	view.channel_stride = (ptrdiff_t)image->width() * image->height() * image->depth();
+	return view;
+}
+
+/*
+ * Little-endian helpers for BMP headers.
+ */
+static unsigned int ReadLittleEndian(const unsigned char* bytes, unsigned int count) {
+	unsigned int value = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		value |= (unsigned int)bytes[i] << (8 * i);
+	}
+	return value;
+}
+
+static void WriteLittleEndian(unsigned char* bytes, unsigned int count, unsigned int value) {
+	for (unsigned int i = 0; i < count; i++) {
+		bytes[i] = (unsigned char)(value >> (8 * i));
+	}
+}
+
+MappedImage::MappedImage() {
+	memset(&view, 0, sizeof(view));
+	mapping = NULL;
+	mapping_size = 0;
+	writable = false;
+#ifdef _WIN32
+	file_handle = INVALID_HANDLE_VALUE;
+	mapping_handle = NULL;
+#else
+	file_descriptor = -1;
+#endif
+}
+
+MappedImage::~MappedImage() {
+	this->Close();
+}
+
+bool MappedImage::Open(const char* path, unsigned int rawWidth,
+	unsigned int rawHeight, unsigned int rawChannels) {
+	ImageFormat format = FormatFromPath(path);
+	if (format == ImageFormat::Unknown || !this->Map(path, 0)) {
+		return false;
+	}
+
+	bool success = false;
+	if (format == ImageFormat::Raw) {
+		success = (rawChannels == 1 || rawChannels == 3) &&
+			this->SetView(0, rawWidth, rawHeight, rawChannels, rawChannels,
+				(size_t)rawWidth * rawChannels, false, false);
+	}
+	else if (format == ImageFormat::Bmp) {
+		success = this->ParseBmp();
+	}
+	else {
+		success = this->ParseNetpbm();
+	}
+
+	if (!success) {
+		this->Close();
+	}
+	return success;
+}
+
+bool MappedImage::Create(const char* path, ImageFormat format, unsigned int width,
+	unsigned int height, unsigned int channels) {
+	if (width == 0 || height == 0 || (channels != 1 && channels != 3) ||
+		(format == ImageFormat::Pgm && channels != 1) ||
+		(format == ImageFormat::Ppm && channels != 3) ||
+		format == ImageFormat::Unknown) {
+		return false;
+	}
+
+	// Rows of BMP are padded to 4 bytes, other formats are not padded.
+	size_t row_bytes = (size_t)width * channels;
+	size_t offset = 0;
+	char header[64];
+	if (format == ImageFormat::Bmp) {
+		row_bytes = (row_bytes + 3) & ~(size_t)3;
+		offset = 14 + 40 + (channels == 1 ? 256 * 4 : 0);
+	}
+	else if (format != ImageFormat::Raw) {
+		int length = snprintf(header, sizeof(header), "P%c\n%u %u\n255\n",
+			format == ImageFormat::Pgm ? '5' : '6', width, height);
+		if (length <= 0 || (size_t)length >= sizeof(header)) {
+			return false;
+		}
+		offset = (size_t)length;
+	}
+
+	if (!this->Map(path, offset + row_bytes * height)) {
+		return false;
+	}
+
+	if (format == ImageFormat::Bmp) {
+		// File header.
+		memset(mapping, 0, offset);
+		mapping[0] = 'B';
+		mapping[1] = 'M';
+		WriteLittleEndian(mapping + 2, 4, (unsigned int)mapping_size);
+		WriteLittleEndian(mapping + 10, 4, (unsigned int)offset);
+		// Info header.
+		WriteLittleEndian(mapping + 14, 4, 40);
+		WriteLittleEndian(mapping + 18, 4, width);
+		WriteLittleEndian(mapping + 22, 4, height);
+		WriteLittleEndian(mapping + 26, 2, 1);
+		WriteLittleEndian(mapping + 28, 2, channels * 8);
+		WriteLittleEndian(mapping + 34, 4, (unsigned int)(row_bytes * height));
+		// Gray palette.
+		if (channels == 1) {
+			WriteLittleEndian(mapping + 46, 4, 256);
+			for (unsigned int i = 0; i < 256; i++) {
+				mapping[54 + i * 4] = (unsigned char)i;
+				mapping[54 + i * 4 + 1] = (unsigned char)i;
+				mapping[54 + i * 4 + 2] = (unsigned char)i;
+			}
+		}
+		// Padding bytes are never written through the view.
+		for (unsigned int i = 0; i < height; i++) {
+			memset(mapping + offset + i * row_bytes + (size_t)width * channels, 0,
+				row_bytes - (size_t)width * channels);
+		}
+	}
+	else if (format != ImageFormat::Raw) {
+		memcpy(mapping, header, offset);
+	}
+
+	return this->SetView(offset, width, height, channels, channels, row_bytes,
+		format == ImageFormat::Bmp, format == ImageFormat::Bmp);
+}
+
+void MappedImage::Close() {
+#ifdef _WIN32
+	if (mapping != NULL) {
+		if (writable) {
+			FlushViewOfFile(mapping, 0);
+		}
+		UnmapViewOfFile(mapping);
+	}
+	if (mapping_handle != NULL) {
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_handle);
+	}
+	file_handle = INVALID_HANDLE_VALUE;
+	mapping_handle = NULL;
+#else
+	if (mapping != NULL) {
+		munmap(mapping, mapping_size);
+	}
+	if (file_descriptor != -1) {
+		close(file_descriptor);
+	}
+	file_descriptor = -1;
+#endif
+	memset(&view, 0, sizeof(view));
+	mapping = NULL;
+	mapping_size = 0;
+	writable = false;
+}
+
+const ImageView& MappedImage::View() const {
+	return view;
+}
+
+ImageFormat MappedImage::FormatFromPath(const char* path) {
+	const char* extension = strrchr(path, '.');
+	if (extension == NULL) {
+		return ImageFormat::Unknown;
+	}
+
+	char lower[8];
+	size_t length = strlen(extension + 1);
+	if (length >= sizeof(lower)) {
+		return ImageFormat::Unknown;
+	}
+	for (size_t i = 0; i <= length; i++) {
+		lower[i] = (char)tolower((unsigned char)extension[i + 1]);
+	}
+
+	if (strcmp(lower, "pgm") == 0) {
+		return ImageFormat::Pgm;
+	}
+	if (strcmp(lower, "ppm") == 0) {
+		return ImageFormat::Ppm;
+	}
+	if (strcmp(lower, "bmp") == 0) {
+		return ImageFormat::Bmp;
+	}
+	if (strcmp(lower, "raw") == 0) {
+		return ImageFormat::Raw;
+	}
+	return ImageFormat::Unknown;
+}
+
+bool MappedImage::Map(const char* path, size_t size) {
+	this->Close();
+	writable = (size != 0);
+
+#ifdef _WIN32
+	file_handle = CreateFileA(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ, NULL, writable ? CREATE_ALWAYS : OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		this->Close();
+		return false;
+	}
+
+	if (!writable) {
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file_handle, &file_size)) {
+			this->Close();
+			return false;
+		}
+		size = (size_t)file_size.QuadPart;
+	}
+	if (size == 0) {
+		this->Close();
+		return false;
+	}
+
+	// Mapping object of writable file also sets its size.
+	unsigned long long size64 = size;
+	mapping_handle = CreateFileMappingA(file_handle, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+		(DWORD)(size64 >> 32), (DWORD)(size64 & 0xFFFFFFFF), NULL);
+	if (mapping_handle == NULL) {
+		this->Close();
+		return false;
+	}
+
+	mapping = (unsigned char*)MapViewOfFile(mapping_handle, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+		0, 0, size);
+	if (mapping == NULL) {
+		this->Close();
+		return false;
+	}
+#else
+	file_descriptor = writable ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path, O_RDONLY);
+	if (file_descriptor == -1) {
+		this->Close();
+		return false;
+	}
+
+	if (writable) {
+		if (ftruncate(file_descriptor, (off_t)size) != 0) {
+			this->Close();
+			return false;
+		}
+	}
+	else {
+		struct stat file_status;
+		if (fstat(file_descriptor, &file_status) != 0) {
+			this->Close();
+			return false;
+		}
+		size = (size_t)file_status.st_size;
+	}
+	if (size == 0) {
+		this->Close();
+		return false;
+	}
+
+	void* address = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+		MAP_SHARED, file_descriptor, 0);
+	if (address == MAP_FAILED) {
+		this->Close();
+		return false;
+	}
+	mapping = (unsigned char*)address;
+#endif
+
+	mapping_size = size;
+	return true;
+}
+
+bool MappedImage::ParseNetpbm() {
+	if (mapping_size < 2 || mapping[0] != 'P' || (mapping[1] != '5' && mapping[1] != '6')) {
+		return false;
+	}
+	unsigned int channels = (mapping[1] == '5') ? 1 : 3;
+
+	// Width, height and maximal value, separated by whitespaces and comments.
+	unsigned int values[3];
+	size_t i = 2;
+	for (int v = 0; v < 3; v++) {
+		while (i < mapping_size && (isspace(mapping[i]) || mapping[i] == '#')) {
+			if (mapping[i] == '#') {
+				while (i < mapping_size && mapping[i] != '\n') {
+					i++;
+				}
+			}
+			else {
+				i++;
+			}
+		}
+		if (i >= mapping_size || !isdigit(mapping[i])) {
+			return false;
+		}
+		values[v] = 0;
+		while (i < mapping_size && isdigit(mapping[i])) {
+			unsigned int digit = mapping[i] - '0';
+			if (values[v] > (UINT_MAX - digit) / 10) {
+				return false;
+			}
+			values[v] = values[v] * 10 + digit;
+			i++;
+		}
+	}
+
+	// Exactly one whitespace separates header from pixels.
+	if (i >= mapping_size || !isspace(mapping[i]) || values[2] == 0 || values[2] > 255) {
+		return false;
+	}
+	i++;
+
+	return this->SetView(i, values[0], values[1], channels, channels,
+		(size_t)values[0] * channels, false, false);
+}
+
+bool MappedImage::ParseBmp() {
+	if (mapping_size < 54 || mapping[0] != 'B' || mapping[1] != 'M') {
+		return false;
+	}
+
+	size_t offset = ReadLittleEndian(mapping + 10, 4);
+	size_t header_size = ReadLittleEndian(mapping + 14, 4);
+	int width = (int)ReadLittleEndian(mapping + 18, 4);
+	int height = (int)ReadLittleEndian(mapping + 22, 4);
+	unsigned int bits = ReadLittleEndian(mapping + 28, 2);
+	unsigned int compression = ReadLittleEndian(mapping + 30, 4);
+
+	// Only uncompressed files with BITMAPINFOHEADER (or newer), negative
+	// height means top-down rows. All offsets come from the file, so they
+	// are checked against the mapping before anything is read.
+	if (compression != 0 || width <= 0 || height == 0 || height == INT_MIN ||
+		header_size < 40 || offset > mapping_size || 14 + header_size > mapping_size) {
+		return false;
+	}
+	bool bottom_up = (height > 0);
+	if (height < 0) {
+		height = -height;
+	}
+
+	unsigned int channels = 3;
+	if (bits == 8) {
+		// Palette must map index to gray level, otherwise pixels are not
+		// usable without decoding.
+		size_t palette = 14 + header_size;
+		size_t colors = ReadLittleEndian(mapping + 46, 4);
+		if (colors == 0) {
+			colors = 256;
+		}
+		if (colors > 256 || palette + colors * 4 > offset || palette + colors * 4 > mapping_size) {
+			return false;
+		}
+		for (size_t i = 0; i < colors; i++) {
+			const unsigned char* color = mapping + palette + i * 4;
+			if (color[0] != i || color[1] != i || color[2] != i) {
+				return false;
+			}
+		}
+		channels = 1;
+	}
+	else if (bits != 24 && bits != 32) {
+		return false;
+	}
+
+	size_t row_bytes = (((size_t)width * bits + 31) / 32) * 4;
+	if ((size_t)height > (mapping_size - offset) / row_bytes) {
+		return false;
+	}
+	return this->SetView(offset, width, height, channels, bits / 8, row_bytes,
+		channels == 3, bottom_up);
+}
+
+bool MappedImage::SetView(size_t offset, unsigned int width, unsigned int height,
+	unsigned int channels, unsigned int bytesPerPixel, size_t rowBytes,
+	bool bgr, bool bottomUp) {
+	// Sizes come from the file (or caller), so every bound is checked by
+	// division; products of them may overflow size_t.
+	if (width == 0 || height == 0 || bytesPerPixel == 0 || offset > mapping_size ||
+		width > (mapping_size - offset) / bytesPerPixel || rowBytes / bytesPerPixel < width) {
+		return false;
+	}
+	size_t last_row = mapping_size - offset - (size_t)width * bytesPerPixel;
+	if (height - 1 > last_row / rowBytes) {
+		return false;
+	}
+
+	view.width = width;
+	view.height = height;
+	view.channels = channels;
+	view.pixel_stride = bytesPerPixel;
+	view.data = mapping + offset;
+	view.row_stride = (ptrdiff_t)rowBytes;
+	if (bottomUp) {
+		view.data += (height - 1) * rowBytes;
+		view.row_stride = -view.row_stride;
+	}
+	view.channel_stride = 1;
+	if (bgr) {
+		view.data += channels - 1;
+		view.channel_stride = -1;
+	}
+	return true;
+}
@@ -0,0 +1,243 @@
+/**
+ * \file      ImageIO.h
+ * \brief     Memory-mapped image input/output header file.
+ * \details   Uncompressed PGM, PPM, BMP and raw files are mapped into memory
+ *            and exposed as strided views, so that pixels are read and
+ *            written in place, without decoding into intermediate buffers.
+ */
+
+#ifndef _IMAGEIO_H_
+#define _IMAGEIO_H_
+#include <stddef.h>
+#include "CImg.h"
+using namespace cimg_library;
+
+/**
+ * \brief Strided view of 8-bit image data.
+ *
+ * View does not own the data. Strides are in bytes and may be negative,
+ * which allows to describe planar (CImg), interleaved (PGM, PPM, raw) and
+ * bottom-up BGR (BMP) layouts the same way. Channel 0 is always red (or
+ * gray for one channel images).
+ */
+struct ImageView {
+	/**
+	 * \var First channel of the upper left pixel.
+	 */
+	unsigned char* data;
+
+	/**
+	 * \var Width of image, in pixels.
+	 */
+	unsigned int width;
+
+	/**
+	 * \var Height of image, in pixels.
+	 */
+	unsigned int height;
+
+	/**
+	 * \var Number of channels (1 or 3).
+	 */
+	unsigned int channels;
+
+	/**
+	 * \var Distance between neighbouring pixels of one row.
+	 */
+	ptrdiff_t pixel_stride;
+
+	/**
+	 * \var Distance between neighbouring rows.
+	 */
+	ptrdiff_t row_stride;
+
+	/**
+	 * \var Distance between neighbouring channels of one pixel.
+	 */
+	ptrdiff_t channel_stride;
+
+	/**
+	 * \brief Gets reference to one channel of (x, y) pixel.
+	 *
+	 * \param x Pixel x coordinate (row).
+	 * \param y Pixel y coordinate (column).
+	 * \param c Channel.
+	 * \return Reference to the channel value.
+	 */
+	inline unsigned char& At(unsigned int x, unsigned int y, unsigned int c) const {
+		return data[x * row_stride + y * pixel_stride + c * channel_stride];
+	}
+
+	/**
+	 * \brief Creates view of planar CImg image.
+	 *
+	 * \param image Image, must stay alive as long as the view is used.
+	 * \return View of the first slice of the image.
+	 */
+	static ImageView FromCImg(CImg<unsigned char>* image);
+};
+
+/**
+ * \brief Supported file formats.
+ */
+enum class ImageFormat {
+	Unknown,
+	Raw,
+	Pgm,
+	Ppm,
+	Bmp
+};
+
+/**
+ * \brief Image file mapped into memory.
+ *
+ * `Open()` maps existing file read-only, `Create()` creates file of
+ * required size, writes its header and maps it for writing. Pixel data
+ * is then accessed through `View()`. Only uncompressed files are
+ * supported: binary PGM (P5) and PPM (P6) with maximal value up to 255,
+ * BMP with 8 (gray palette), 24 or 32 bits per pixel and raw interleaved
+ * files without header.
+ */
+class MappedImage {
+public:
+	/**
+	 * \brief Constructor, initializes some private variables.
+	 */
+	MappedImage();
+
+	/**
+	 * \brief Destructor, unmaps the file.
+	 */
+	~MappedImage();
+
+	/**
+	 * \brief Maps existing image file read-only.
+	 *
+	 * Pixels must not be written through the view of opened file.
+	 *
+	 * \param path Path of the file.
+	 * \param rawWidth Width of raw image (ignored for other formats).
+	 * \param rawHeight Height of raw image (ignored for other formats).
+	 * \param rawChannels Channels of raw image (ignored for other formats).
+	 * \return True on success.
+	 */
+	bool Open(const char* path, unsigned int rawWidth = 0,
+		unsigned int rawHeight = 0, unsigned int rawChannels = 0);
+
+	/**
+	 * \brief Creates image file and maps it for writing.
+	 *
+	 * PGM needs 1 channel, PPM needs 3 channels, BMP and raw take both.
+	 * Existing file is overwritten. Contents of pixels are undefined until
+	 * written.
+	 *
+	 * \param path Path of the file.
+	 * \param format Format of the file.
+	 * \param width Width of image, in pixels.
+	 * \param height Height of image, in pixels.
+	 * \param channels Number of channels (1 or 3).
+	 * \return True on success.
+	 */
+	bool Create(const char* path, ImageFormat format, unsigned int width,
+		unsigned int height, unsigned int channels);
+
+	/**
+	 * \brief Unmaps the file. Written pixels are flushed to disk.
+	 */
+	void Close();
+
+	/**
+	 * \brief Gets view of pixel data.
+	 *
+	 * \return View, valid until the file is closed.
+	 */
+	const ImageView& View() const;
+
+	/**
+	 * \brief Guesses file format from extension of the path.
+	 *
+	 * \param path Path of the file.
+	 * \return File format, `ImageFormat::Unknown` if not supported.
+	 */
+	static ImageFormat FormatFromPath(const char* path);
+
+private:
+	/**
+	 * \var View of mapped pixel data.
+	 */
+	ImageView view;
+
+	/**
+	 * \var Start of mapped file.
+	 */
+	unsigned char* mapping;
+
+	/**
+	 * \var Size of mapped file, in bytes.
+	 */
+	size_t mapping_size;
+
+	/**
+	 * \var True if file is mapped for writing.
+	 */
+	bool writable;
+
+#ifdef _WIN32
+	/**
+	 * \var Handle of the file.
+	 */
+	void* file_handle;
+
+	/**
+	 * \var Handle of the file mapping object.
+	 */
+	void* mapping_handle;
+#else
+	/**
+	 * \var Descriptor of the file.
+	 */
+	int file_descriptor;
+#endif
+
+	/**
+	 * \brief Maps file into memory.
+	 *
+	 * \param path Path of the file.
+	 * \param size Size of created file, 0 opens existing file read-only.
+	 * \return True on success.
+	 */
+	bool Map(const char* path, size_t size);
+
+	/**
+	 * \brief Parses PGM or PPM header and sets up the view.
+	 *
+	 * \return True on success.
+	 */
+	bool ParseNetpbm();
+
+	/**
+	 * \brief Parses BMP header and sets up the view.
+	 *
+	 * \return True on success.
+	 */
+	bool ParseBmp();
+
+	/**
+	 * \brief Sets up view of interleaved pixels.
+	 *
+	 * \param offset Offset of first pixel from start of the file.
+	 * \param width Width of image, in pixels.
+	 * \param height Height of image, in pixels.
+	 * \param channels Number of channels stored.
+	 * \param bytesPerPixel Bytes per stored pixel.
+	 * \param rowBytes Bytes per stored row (including padding).
+	 * \param bgr True if channels are stored in BGR order.
+	 * \param bottomUp True if first stored row is the bottom one.
+	 * \return True if the pixels fit into the file.
+	 */
+	bool SetView(size_t offset, unsigned int width, unsigned int height,
+		unsigned int channels, unsigned int bytesPerPixel, size_t rowBytes,
+		bool bgr, bool bottomUp);
+};
+
+#endif // #ifndef _IMAGEIO_H_
@@ -0,0 +1,306 @@
+/**
+ * \file      PixelBuffer.h
+ * \brief     Two-dimensional pixel container used by Canny algorithm.
+ * \details   Rows are aligned to cache lines. Optionally the buffer is
+ *            split into square tiles stored one after another, so that
+ *            neighbouring rows of a tile are close in memory.
+ */
+
+#ifndef _PIXELBUFFER_H_
+#define _PIXELBUFFER_H_
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \brief Two-dimensional pixel container.
+ *
+ * Pixels are addressed in the same manner as in `CannyEdgeDetector`: x is
+ * the row counter and y is the column counter.
+ *
+ * In linear layout rows follow each other, `Stride()` elements apart; the
+ * stride is rounded up so that every row starts on a cache line. In tiled
+ * layout the image is split into `TileSize()` x `TileSize()` tiles, every
+ * tile is stored contiguously row by row and tiles follow each other row
+ * by row. `ForEach()` visits pixels in memory order for both layouts.
+ */
+template<typename T>
+class PixelBuffer {
+public:
+	/**
+	 * \var Alignment of rows and tiles, in bytes.
+	 */
+	static const size_t ALIGNMENT = 64;
+
+	/**
+	 * \brief Constructor, creates empty buffer.
+	 */
+	PixelBuffer() {
+		storage = NULL;
+		data = NULL;
+		size = 0;
+		width = 0;
+		height = 0;
+		stride = 0;
+		tile_shift = 0;
+		tiles_per_row = 0;
+	}
+
+	/**
+	 * \brief Destructor, unallocates memory.
+	 */
+	~PixelBuffer() {
+		delete[] storage;
+	}
+
+	/**
+	 * \brief Allocates buffer, previous contents are lost.
+	 *
+	 * \param width Width of buffer, in pixels.
+	 * \param height Height of buffer, in pixels.
+	 * \param tileSize Size of tile side, power of two; 0 selects linear
+	 * layout.
+	 */
+	void Allocate(unsigned int width, unsigned int height, unsigned int tileSize = 0) {
+		this->width = width;
+		this->height = height;
+
+		size_t count;
+		if (tileSize == 0) {
+			size_t per_line = ALIGNMENT / sizeof(T);
+			if (per_line == 0) {
+				per_line = 1;
+			}
+			stride = (width + per_line - 1) / per_line * per_line;
+			tile_shift = 0;
+			tiles_per_row = 0;
+			count = stride * height;
+		}
+		else {
+			tile_shift = 0;
+			while ((1u << tile_shift) < tileSize) {
+				tile_shift++;
+			}
+			stride = (size_t)1 << tile_shift;
+			tiles_per_row = (width + (unsigned int)stride - 1) >> tile_shift;
+			size_t tile_rows = (height + stride - 1) >> tile_shift;
+			count = tiles_per_row * tile_rows * stride * stride;
+		}
+
+		delete[] storage;
+		storage = new unsigned char[count * sizeof(T) + ALIGNMENT];
+		size_t misalignment = (size_t)(uintptr_t)storage % ALIGNMENT;
+		data = (T*)(storage + (misalignment == 0 ? 0 : ALIGNMENT - misalignment));
+		size = count;
+	}
+
+	/**
+	 * \brief Sets every element (including padding) to certain value.
+	 *
+	 * \param value Value.
+	 */
+	void Fill(const T& value) {
+		for (size_t i = 0; i < size; i++) {
+			data[i] = value;
+		}
+	}
+
+	/**
+	 * \brief Gets reference to (x, y) pixel.
+	 *
+	 * \param x Pixel x coordinate (row).
+	 * \param y Pixel y coordinate (column).
+	 * \return Reference to the pixel.
+	 */
+	inline T& operator()(unsigned int x, unsigned int y) {
+		if (tiles_per_row == 0) {
+			return data[x * stride + y];
+		}
+		size_t mask = stride - 1;
+		size_t tile = (x >> tile_shift) * tiles_per_row + (y >> tile_shift);
+		return data[(tile << (2 * tile_shift)) + ((x & mask) << tile_shift) + (y & mask)];
+	}
+
+	/**
+	 * \brief Calls function for every pixel of a rectangle in memory order.
+	 *
+	 * \param x0 First row.
+	 * \param x1 Row after last row.
+	 * \param y0 First column.
+	 * \param y1 Column after last column.
+	 * \param function Function called with x and y coordinates.
+	 */
+	template<typename F>
+	inline void ForEach(unsigned int x0, unsigned int x1, unsigned int y0, unsigned int y1, F function) {
+		if (tiles_per_row == 0) {
+			for (unsigned int x = x0; x < x1; x++) {
+				for (unsigned int y = y0; y < y1; y++) {
+					function(x, y);
+				}
+			}
+			return;
+		}
+
+		unsigned int tile = (unsigned int)stride;
+		for (unsigned int tx = x0 & ~(tile - 1); tx < x1; tx += tile) {
+			unsigned int row_begin = tx > x0 ? tx : x0;
+			unsigned int row_end = tx + tile < x1 ? tx + tile : x1;
+			for (unsigned int ty = y0 & ~(tile - 1); ty < y1; ty += tile) {
+				unsigned int column_begin = ty > y0 ? ty : y0;
+				unsigned int column_end = ty + tile < y1 ? ty + tile : y1;
+				for (unsigned int x = row_begin; x < row_end; x++) {
+					for (unsigned int y = column_begin; y < column_end; y++) {
+						function(x, y);
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * \brief Calls function for every pixel of a rectangle in reverse
+	 * memory order.
+	 *
+	 * Visits exactly the pixels of `ForEach()`, last one first.
+	 *
+	 * \param x0 First row.
+	 * \param x1 Row after last row.
+	 * \param y0 First column.
+	 * \param y1 Column after last column.
+	 * \param function Function called with x and y coordinates.
+	 */
+	template<typename F>
+	inline void ForEachReverse(unsigned int x0, unsigned int x1, unsigned int y0, unsigned int y1, F function) {
+		if (x0 >= x1 || y0 >= y1) {
+			return;
+		}
+		if (tiles_per_row == 0) {
+			for (unsigned int x = x1; x-- > x0;) {
+				for (unsigned int y = y1; y-- > y0;) {
+					function(x, y);
+				}
+			}
+			return;
+		}
+
+		unsigned int tile = (unsigned int)stride;
+		for (unsigned int tx = (x1 - 1) & ~(tile - 1); ; tx -= tile) {
+			unsigned int row_begin = tx > x0 ? tx : x0;
+			unsigned int row_end = tx + tile < x1 ? tx + tile : x1;
+			for (unsigned int ty = (y1 - 1) & ~(tile - 1); ; ty -= tile) {
+				unsigned int column_begin = ty > y0 ? ty : y0;
+				unsigned int column_end = ty + tile < y1 ? ty + tile : y1;
+				for (unsigned int x = row_end; x-- > row_begin;) {
+					for (unsigned int y = column_end; y-- > column_begin;) {
+						function(x, y);
+					}
+				}
+				if (ty <= y0) {
+					break;
+				}
+			}
+			if (tx <= x0) {
+				break;
+			}
+		}
+	}
+
+	/**
+	 * \brief Gets width of buffer.
+	 *
+	 * \return Width, in pixels.
+	 */
+	unsigned int Width() const {
+		return width;
+	}
+
+	/**
+	 * \brief Gets height of buffer.
+	 *
+	 * \return Height, in pixels.
+	 */
+	unsigned int Height() const {
+		return height;
+	}
+
+	/**
+	 * \brief Gets distance between rows (of image or of tile).
+	 *
+	 * \return Stride, in elements.
+	 */
+	size_t Stride() const {
+		return stride;
+	}
+
+	/**
+	 * \brief Gets size of tile side.
+	 *
+	 * \return Tile size, 0 in linear layout.
+	 */
+	unsigned int TileSize() const {
+		return tiles_per_row == 0 ? 0 : (unsigned int)stride;
+	}
+
+	/**
+	 * \brief Gets number of allocated elements, including padding.
+	 *
+	 * \return Number of elements.
+	 */
+	size_t Size() const {
+		return size;
+	}
+
+	/**
+	 * \brief Gets number of bytes held, including padding and alignment.
+	 *
+	 * \return Number of bytes.
+	 */
+	size_t Bytes() const {
+		return storage == NULL ? 0 : size * sizeof(T) + ALIGNMENT;
+	}
+
+private:
+	/**
+	 * \var Allocated memory, not aligned.
+	 */
+	unsigned char* storage;
+
+	/**
+	 * \var First pixel, aligned to `ALIGNMENT`.
+	 */
+	T* data;
+
+	/**
+	 * \var Number of allocated elements.
+	 */
+	size_t size;
+
+	/**
+	 * \var Width of buffer, in pixels.
+	 */
+	unsigned int width;
+
+	/**
+	 * \var Height of buffer, in pixels.
+	 */
+	unsigned int height;
+
+	/**
+	 * \var Distance between rows (of image or of tile), in elements.
+	 */
+	size_t stride;
+
+	/**
+	 * \var Binary logarithm of tile size, 0 in linear layout.
+	 */
+	unsigned int tile_shift;
+
+	/**
+	 * \var Number of tiles in one row of tiles, 0 in linear layout.
+	 */
+	size_t tiles_per_row;
+
+	PixelBuffer(const PixelBuffer&);
+	PixelBuffer& operator=(const PixelBuffer&);
+};
+
+#endif // #ifndef _PIXELBUFFER_H_